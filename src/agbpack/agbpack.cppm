@@ -3,10 +3,13 @@
 
 export module agbpack;
 
+export import :archive;
 export import :common;
 export import :delta;
 export import :exceptions;
 export import :header;
 export import :huffman;
 export import :lzss;
+export import :parallel;
 export import :rle;
+export import :solid;
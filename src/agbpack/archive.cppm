@@ -0,0 +1,293 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+export module agbpack:archive;
+import :common;
+import :delta;
+import :exceptions;
+import :header;
+import :huffman;
+import :lzss;
+import :rle;
+
+namespace agbpack
+{
+
+using std::vector;
+
+// Archive layout. All values are 32 bit little endian words:
+// * Magic ("AGBA")
+// * Number of entries
+// * Directory: one 16 byte record per entry:
+//   * FNV-1a hash of the entry's name
+//   * Offset of the entry's stream, relative to the beginning of the archive
+//   * Size of the entry's stream in bytes
+//   * Header of the entry's stream, which holds compression type, options and uncompressed size
+// * Streams. Each stream is a GBA BIOS compatible stream starting at a 4 byte aligned offset.
+inline constexpr agbpack_u32 archive_magic = 0x41424741;
+inline constexpr std::size_t archive_header_size = 8;
+inline constexpr std::size_t archive_directory_entry_size = 16;
+
+// Returns the name hash used to look up archive entries (32 bit FNV-1a).
+export constexpr agbpack_u32 archive_name_hash(std::string_view name)
+{
+    fnv1a_hash<agbpack_u32> hash;
+    for (auto c : name)
+    {
+        hash.update(static_cast<agbpack_u8>(c));
+    }
+
+    return hash.value();
+}
+
+inline std::optional<header> parse_any_header(agbpack_u32 header_data)
+{
+    return header::parse_for_type(compression_type((header_data >> 4) & 0xf), header_data);
+}
+
+export class archive_entry final
+{
+public:
+    explicit archive_entry(agbpack_u32 name_hash, agbpack_u32 offset, agbpack_u32 size, header header)
+        : m_name_hash(name_hash)
+        , m_offset(offset)
+        , m_size(size)
+        , m_header(header)
+    {}
+
+    agbpack_u32 name_hash() const { return m_name_hash; }
+
+    agbpack_u32 offset() const { return m_offset; }
+
+    agbpack_u32 size() const { return m_size; }
+
+    compression_type type() const { return m_header.type(); }
+
+    agbpack_u32 uncompressed_size() const { return m_header.uncompressed_size(); }
+
+private:
+    agbpack_u32 m_name_hash;
+    agbpack_u32 m_offset;
+    agbpack_u32 m_size;
+    header m_header;
+};
+
+// Collects encoded streams and writes them into an archive.
+// Streams are added as produced by the agbpack encoders, so they can be encoded in parallel before being added.
+// Entries are written in the order in which they were added.
+export class archive_writer final
+{
+public:
+    template <std::input_iterator InputIterator>
+    void add(std::string_view name, InputIterator input, InputIterator eof)
+    {
+        static_assert_input_type<InputIterator>();
+        add(name, vector<agbpack_u8>(input, eof));
+    }
+
+    void add(std::string_view name, vector<agbpack_u8> encoded_data)
+    {
+        const auto name_hash = archive_name_hash(name);
+        if (m_hashes.contains(name_hash))
+        {
+            throw std::invalid_argument("duplicate archive entry name hash");
+        }
+
+        if (encoded_data.size() < header_size)
+        {
+            throw std::invalid_argument("encoded data has no valid header");
+        }
+
+        byte_reader<vector<agbpack_u8>::const_iterator> reader(encoded_data.begin(), encoded_data.end());
+        const auto header = parse_any_header(read32(reader));
+        if (!header)
+        {
+            throw std::invalid_argument("encoded data has no valid header");
+        }
+
+        m_hashes.emplace(name_hash, m_streams.size());
+        m_streams.push_back({ name_hash, header->to_uint32_t(), std::move(encoded_data) });
+    }
+
+    std::size_t size() const
+    {
+        return m_streams.size();
+    }
+
+    template <typename OutputIterator>
+    void write(OutputIterator output) const
+    {
+        unbounded_byte_writer<OutputIterator> writer(output);
+
+        write32(writer, archive_magic);
+        write32(writer, to_u32(m_streams.size()));
+
+        auto offset = archive_header_size + archive_directory_entry_size * m_streams.size();
+        for (const auto& stream : m_streams)
+        {
+            write32(writer, stream.name_hash);
+            write32(writer, to_u32(offset));
+            write32(writer, to_u32(stream.encoded_data.size()));
+            write32(writer, stream.header_data);
+            offset = round_up_to_multiple_of_4(offset + stream.encoded_data.size());
+        }
+
+        for (const auto& stream : m_streams)
+        {
+            agbpack::write(writer, stream.encoded_data.begin(), stream.encoded_data.end());
+            write_padding_bytes(writer);
+        }
+    }
+
+private:
+    struct stream_data final
+    {
+        agbpack_u32 name_hash;
+        agbpack_u32 header_data;
+        vector<agbpack_u8> encoded_data;
+    };
+
+    static std::size_t round_up_to_multiple_of_4(std::size_t n)
+    {
+        return (n + 3) & ~std::size_t(3);
+    }
+
+    static agbpack_u32 to_u32(std::size_t n)
+    {
+        if (n > 0xffffffff)
+        {
+            throw encode_exception("archive is too big");
+        }
+
+        return static_cast<agbpack_u32>(n);
+    }
+
+    std::unordered_map<agbpack_u32, std::size_t> m_hashes;
+    vector<stream_data> m_streams;
+};
+
+// Provides access to the entries of an archive created by archive_writer.
+// The archive is not copied: the reader refers to the memory passed to it, which
+// must outlive the reader. This allows the archive to be memory mapped by the caller.
+// The directory is checked when the reader is created. The streams are only checked when they are decoded.
+export class archive_reader final
+{
+public:
+    explicit archive_reader(std::span<const agbpack_u8> archive)
+        : m_archive(archive)
+    {
+        byte_reader<std::span<const agbpack_u8>::iterator> reader(m_archive.begin(), m_archive.end());
+
+        if (read32(reader) != archive_magic)
+        {
+            throw decode_exception("not an archive");
+        }
+
+        const auto nentries = read32(reader);
+        if (nentries > (m_archive.size() - archive_header_size) / archive_directory_entry_size)
+        {
+            throw decode_exception();
+        }
+
+        m_entries.reserve(nentries);
+        m_hashes.reserve(nentries);
+        for (agbpack_u32 i = 0; i < nentries; ++i)
+        {
+            const auto name_hash = read32(reader);
+            const auto offset = read32(reader);
+            const auto size = read32(reader);
+            const auto header = parse_any_header(read32(reader));
+
+            if (!header || (offset % 4) || (size < header_size) || (offset > m_archive.size()) || (size > m_archive.size() - offset))
+            {
+                throw decode_exception();
+            }
+
+            if (!m_hashes.emplace(name_hash, m_entries.size()).second)
+            {
+                throw decode_exception("duplicate archive entry name hash");
+            }
+
+            m_entries.emplace_back(name_hash, offset, size, *header);
+        }
+    }
+
+    const vector<archive_entry>& entries() const
+    {
+        return m_entries;
+    }
+
+    // Returns the entry with the given name, or nullptr if there is no such entry.
+    const archive_entry* find(std::string_view name) const
+    {
+        return find(archive_name_hash(name));
+    }
+
+    const archive_entry* find(agbpack_u32 name_hash) const
+    {
+        auto it = m_hashes.find(name_hash);
+        return it != m_hashes.end() ? &m_entries[it->second] : nullptr;
+    }
+
+    // Returns the encoded stream of an entry, e.g. to copy it to the ROM unchanged.
+    std::span<const agbpack_u8> stream(const archive_entry& entry) const
+    {
+        return m_archive.subspan(entry.offset(), entry.size());
+    }
+
+    // Decodes the entry with the given name.
+    // Throws std::out_of_range if there is no such entry.
+    template <typename OutputIterator>
+    void decode(std::string_view name, OutputIterator output) const
+    {
+        auto entry = find(name);
+        if (!entry)
+        {
+            throw std::out_of_range("no such archive entry");
+        }
+
+        decode(*entry, output);
+    }
+
+    template <typename OutputIterator>
+    void decode(const archive_entry& entry, OutputIterator output) const
+    {
+        const auto data = stream(entry);
+        switch (entry.type())
+        {
+            case compression_type::lzss:
+                lzss_decoder().decode(data.begin(), data.end(), output);
+                return;
+            case compression_type::huffman:
+                huffman_decoder().decode(data.begin(), data.end(), output);
+                return;
+            case compression_type::rle:
+                rle_decoder().decode(data.begin(), data.end(), output);
+                return;
+            case compression_type::delta:
+                delta_decoder().decode(data.begin(), data.end(), output);
+                return;
+        }
+
+        throw internal_error("invalid compression type, but this line should never be reached");
+    }
+
+private:
+    std::span<const agbpack_u8> m_archive;
+    vector<archive_entry> m_entries;
+    std::unordered_map<agbpack_u32, std::size_t> m_hashes;
+};
+
+}
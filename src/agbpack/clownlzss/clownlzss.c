@@ -25,6 +25,8 @@ int ClownLZSS_FindOptimalMatches(
 	void (* const extra_matches_callback)(const unsigned char *data, size_t total_values, size_t offset, ClownLZSS_GraphEdge *node_meta_array, void *user),
 	const size_t literal_cost,
 	size_t (* const match_cost_callback)(size_t distance, size_t length, void *user),
+	int (* const progress_callback)(size_t values_done, size_t total_values, void *user),
+	size_t (* const compare_callback)(const unsigned char *current, const unsigned char *match, size_t maximum_length),
 	const unsigned char* const data,
 	const size_t bytes_per_value,
 	const size_t total_values,
@@ -105,6 +107,15 @@ int ClownLZSS_FindOptimalMatches(
 				if (extra_matches_callback != NULL)
 					extra_matches_callback(data, total_values, i, node_meta_array, (void*)user);
 
+				/* Report progress every 0x1000 values. If the callback returns 0, give up. */
+				if (progress_callback != NULL && i % 0x1000 == 0 && !progress_callback(i, total_values, (void*)user))
+				{
+					free(node_meta_array);
+					*_matches = NULL;
+					*_total_matches = 0;
+					return 0;
+				}
+
 				/* `string_list_head` points to a linked-list of strings in the LZSS sliding window that match at least
 				   one byte with the current string: iterate over it and generate every possible match for this string */
 				for (match_string = next[string_list_head]; match_string != DUMMY; match_string = next[match_string])
@@ -117,6 +128,26 @@ int ClownLZSS_FindOptimalMatches(
 					const unsigned char *current_bytes = &data[(i + start) * bytes_per_value];
 					const unsigned char *match_bytes = current_bytes - distance * bytes_per_value;
 
+					/* If the match lies entirely within the data, let the compare callback find the length of the run in one go */
+					if (compare_callback != NULL && bytes_per_value == 1 && match_bytes >= data)
+					{
+						const size_t run_end = start + compare_callback(current_bytes, match_bytes, CLOWNLZSS_MIN(maximum_match_length, total_values - i) - start);
+
+						for (j = start; j < run_end; ++j)
+						{
+							const size_t cost = match_cost_callback(distance, j + 1, (void*)user);
+
+							if (cost != 0 && node_meta_array[i + j + 1].u.cost > node_meta_array[i].u.cost + cost)
+							{
+								node_meta_array[i + j + 1].u.cost = node_meta_array[i].u.cost + cost;
+								node_meta_array[i + j + 1].previous_node_index = i;
+								node_meta_array[i + j + 1].match_offset = i - distance;
+							}
+						}
+
+						continue;
+					}
+
 					for (j = start; j < CLOWNLZSS_MIN(maximum_match_length, total_values - i); ++j)
 					{
 						size_t l;
@@ -53,6 +53,8 @@ int ClownLZSS_FindOptimalMatches(
 	void (*extra_matches_callback)(const unsigned char *data, size_t total_values, size_t offset, ClownLZSS_GraphEdge *node_meta_array, void *user),
 	size_t literal_cost,
 	size_t (*match_cost_callback)(size_t distance, size_t length, void *user),
+	int (*progress_callback)(size_t values_done, size_t total_values, void *user),
+	size_t (*compare_callback)(const unsigned char *current, const unsigned char *match, size_t maximum_length),
 	const unsigned char *data,
 	size_t bytes_per_value,
 	size_t total_values,
@@ -90,6 +92,8 @@ namespace ClownLZSS
 		void (*extra_matches_callback)(const unsigned char *data, size_t total_values, size_t offset, ClownLZSS_GraphEdge *node_meta_array, void *user),
 		size_t literal_cost,
 		size_t (*match_cost_callback)(size_t distance, size_t length, void *user),
+		int (*progress_callback)(size_t values_done, size_t total_values, void *user),
+		size_t (*compare_callback)(const unsigned char *current, const unsigned char *match, size_t maximum_length),
 		const unsigned char *data,
 		size_t bytes_per_value,
 		size_t total_values,
@@ -98,8 +102,8 @@ namespace ClownLZSS
 		const void *user
 	)
 	{
-		ClownLZSS_Match *matches_pointer;
-		const bool success = ClownLZSS_FindOptimalMatches(filler_value, maximum_match_length, maximum_match_distance, extra_matches_callback, literal_cost, match_cost_callback, data, bytes_per_value, total_values, &matches_pointer, total_matches, user);
+		ClownLZSS_Match *matches_pointer = NULL;
+		const bool success = ClownLZSS_FindOptimalMatches(filler_value, maximum_match_length, maximum_match_distance, extra_matches_callback, literal_cost, match_cost_callback, progress_callback, compare_callback, data, bytes_per_value, total_values, &matches_pointer, total_matches, user);
 
 		*matches = Matches(matches_pointer);
 
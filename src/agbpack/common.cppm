@@ -3,12 +3,23 @@
 
 module;
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <concepts>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <iterator>
 #include <limits>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 export module agbpack:common;
 import :exceptions;
@@ -30,6 +41,11 @@ struct size16_tag { using type = agbpack_u16; };
 inline constexpr size8_tag size8;
 inline constexpr size16_tag size16;
 
+// Returned by decoders: in is the position following the end of the encoded stream, which is where the next
+// stream begins if streams are stored back to back, and out is the output iterator following the decoded data.
+export template <typename InputIterator, typename OutputIterator>
+using decode_result = std::ranges::in_out_result<InputIterator, OutputIterator>;
+
 AGBPACK_EXPORT_FOR_UNIT_TESTING
 template <std::input_iterator InputIterator>
 class byte_reader final
@@ -53,6 +69,12 @@ public:
         return m_nbytes_read;
     }
 
+    // Position of the next byte to read.
+    InputIterator input() const
+    {
+        return m_input;
+    }
+
     agbpack_u8 read8()
     {
         if (eof())
@@ -69,6 +91,18 @@ public:
         return *m_input;
     }
 
+    // Skips nbytes bytes of input. Throws if there are fewer bytes left.
+    // For random access iterators this takes constant time.
+    void skip(agbpack_u32 nbytes)
+    {
+        if (std::ranges::advance(m_input, static_cast<std::iter_difference_t<InputIterator>>(nbytes), m_eof) != 0)
+        {
+            throw decode_exception();
+        }
+
+        m_nbytes_read += nbytes;
+    }
+
 private:
     agbpack_u8 read8_internal()
     {
@@ -158,6 +192,11 @@ public:
         return m_nbytes_written;
     }
 
+    OutputIterator output() const
+    {
+        return m_output;
+    }
+
     void write8(agbpack_u8 byte)
     {
         if (done())
@@ -180,6 +219,65 @@ private:
     OutputIterator m_output;
 };
 
+// Byte writer that only passes a range [begin, end) of the output on to the output iterator.
+// Bytes outside of that range are counted but discarded. Like byte_writer it throws
+// if more than nbytes_to_write bytes are written, where position is the number of
+// bytes that have already been written before the writer was created.
+template <typename OutputIterator>
+class byte_range_writer final
+{
+public:
+    byte_range_writer(const byte_range_writer&) = delete;
+    byte_range_writer& operator=(const byte_range_writer&) = delete;
+
+    explicit byte_range_writer(std::size_t nbytes_to_write, std::size_t position, std::size_t begin, std::size_t end, OutputIterator output)
+        : m_nbytes_to_write(nbytes_to_write)
+        , m_position(position)
+        , m_begin(begin)
+        , m_end(end)
+        , m_output(output)
+    {
+        assert((position <= begin) && (begin <= end) && (end <= nbytes_to_write));
+    }
+
+    bool done() const
+    {
+        return m_position >= m_end;
+    }
+
+    std::size_t position() const
+    {
+        return m_position;
+    }
+
+    OutputIterator output() const
+    {
+        return m_output;
+    }
+
+    void write8(agbpack_u8 byte)
+    {
+        if (m_position >= m_nbytes_to_write)
+        {
+            throw decode_exception();
+        }
+
+        if (m_position >= m_begin && m_position < m_end)
+        {
+            *m_output++ = byte;
+        }
+
+        ++m_position;
+    }
+
+private:
+    std::size_t m_nbytes_to_write;
+    std::size_t m_position;
+    std::size_t m_begin;
+    std::size_t m_end;
+    OutputIterator m_output;
+};
+
 AGBPACK_EXPORT_FOR_UNIT_TESTING
 template <typename OutputIterator>
 class unbounded_byte_writer final
@@ -195,6 +293,11 @@ public:
         return m_nbytes_written;
     }
 
+    OutputIterator output() const
+    {
+        return m_output;
+    }
+
     void write8(agbpack_u8 byte)
     {
         *m_output++ = byte;
@@ -258,6 +361,399 @@ void write_padding_bytes(ByteWriter& writer)
     }
 }
 
+// Index of decoder checkpoints, ordered by output offset.
+// Encoders fill an index while encoding. A checkpoint is recorded whenever at least
+// checkpoint_interval bytes of uncompressed data have been encoded since the previous one.
+// Decoders use the index to start decoding at the nearest checkpoint in front of the data
+// they are asked to decode rather than at the beginning of the stream.
+// An interval of 0 disables periodic checkpoints.
+export template <typename Checkpoint>
+class checkpoint_index final
+{
+public:
+    explicit checkpoint_index(std::size_t checkpoint_interval = 0)
+        : m_checkpoint_interval(checkpoint_interval)
+    {}
+
+    std::size_t checkpoint_interval() const
+    {
+        return m_checkpoint_interval;
+    }
+
+    const std::vector<Checkpoint>& checkpoints() const
+    {
+        return m_checkpoints;
+    }
+
+    void clear()
+    {
+        m_checkpoints.clear();
+    }
+
+    // Checkpoints must be added in ascending order of their output offsets, otherwise std::invalid_argument is thrown.
+    void add(Checkpoint checkpoint)
+    {
+        if (!m_checkpoints.empty() && (m_checkpoints.back().output_offset() >= checkpoint.output_offset()))
+        {
+            throw std::invalid_argument("checkpoints must be added in ascending order of output offset");
+        }
+
+        m_checkpoints.push_back(std::move(checkpoint));
+    }
+
+    bool checkpoint_due(std::size_t output_offset) const
+    {
+        if (m_checkpoint_interval == 0)
+        {
+            return false;
+        }
+
+        std::size_t previous_output_offset = m_checkpoints.empty() ? 0 : m_checkpoints.back().output_offset();
+        return output_offset >= previous_output_offset + m_checkpoint_interval;
+    }
+
+    // Returns the last checkpoint whose output offset is not greater than output_offset.
+    // Returns nullptr if there is no such checkpoint, in which case decoding has to start at the beginning of the stream.
+    const Checkpoint* find(std::size_t output_offset) const
+    {
+        auto it = std::ranges::upper_bound(m_checkpoints, output_offset, {}, [](const Checkpoint& c) { return c.output_offset(); });
+        return (it == m_checkpoints.begin()) ? nullptr : &*(it - 1);
+    }
+
+private:
+    std::size_t m_checkpoint_interval;
+    std::vector<Checkpoint> m_checkpoints;
+};
+
+// Time an encoder spent in one of its phases.
+export struct encoder_phase_time final
+{
+    const char* name;
+    std::chrono::nanoseconds time;
+};
+
+// Statistics type used by encoders when no statistics are to be collected.
+// Code collecting statistics is compiled out for this type, so encoding without statistics has no overhead.
+struct no_statistics final {};
+
+template <typename Statistics>
+inline constexpr bool collects_statistics = !std::is_same_v<std::remove_cvref_t<Statistics>, no_statistics>;
+
+// Calls f and returns its result. If statistics are collected, the time f took is added to the time of the named phase.
+template <typename Statistics, typename F>
+auto measure_phase([[maybe_unused]] Statistics& statistics, [[maybe_unused]] const char* name, F f)
+{
+    if constexpr (collects_statistics<Statistics>)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        auto add_phase_time = [&]()
+        {
+            const auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            auto phase = std::ranges::find_if(statistics.phase_times, [name](const encoder_phase_time& p) { return std::string_view(p.name) == name; });
+            if (phase != statistics.phase_times.end())
+            {
+                phase->time += time;
+            }
+            else
+            {
+                statistics.phase_times.push_back({ name, time });
+            }
+        };
+
+        if constexpr (std::is_void_v<decltype(f())>)
+        {
+            f();
+            add_phase_time();
+        }
+        else
+        {
+            auto result = f();
+            add_phase_time();
+            return result;
+        }
+    }
+    else
+    {
+        return f();
+    }
+}
+
+// Allows the progress of encoders to be observed and encoding to be cancelled.
+// Pass an encode_progress to one or more encoders using their progress setter. While encoding, an encoder
+// regularly reports the number of input bytes it has processed and checks whether encoding has been cancelled.
+// If it has, the encoder throws encode_cancelled_exception. Cancelling is permanent: any encoder using a cancelled
+// encode_progress throws, so one encode_progress can be used to cancel all encodes belonging to a job.
+// * Progress can be polled from any thread, or observed through a callback. The callback is called on the
+//   thread that called encode, and exceptions thrown by it are propagated to the caller of encode.
+// * The total is 0 while it is not known, which is the case when the input of the RLE or the delta encoder
+//   is read through iterators which cannot tell the size of the input in advance.
+// * An encode_progress must not be used by several encoders at the same time, except for cancelling.
+export class encode_progress final
+{
+public:
+    using callback = std::function<void(std::size_t nbytes_processed, std::size_t nbytes_total)>;
+
+    explicit encode_progress() = default;
+
+    explicit encode_progress(callback on_progress)
+        : m_callback(std::move(on_progress))
+    {}
+
+    // Cancels encoding. Can be called from any thread at any time.
+    void cancel()
+    {
+        m_cancelled = true;
+    }
+
+    bool cancelled() const
+    {
+        return m_cancelled;
+    }
+
+    std::size_t nbytes_processed() const
+    {
+        return m_nbytes_processed;
+    }
+
+    std::size_t nbytes_total() const
+    {
+        return m_nbytes_total;
+    }
+
+    // Called by encoders to report progress.
+    // Throws encode_cancelled_exception if encoding has been cancelled.
+    void report(std::size_t nbytes_processed, std::size_t nbytes_total)
+    {
+        m_nbytes_processed = nbytes_processed;
+        m_nbytes_total = nbytes_total;
+        if (m_callback)
+        {
+            m_callback(nbytes_processed, nbytes_total);
+        }
+
+        throw_if_cancelled();
+    }
+
+    void throw_if_cancelled() const
+    {
+        if (m_cancelled)
+        {
+            throw encode_cancelled_exception();
+        }
+    }
+
+private:
+    callback m_callback;
+    std::atomic<bool> m_cancelled = false;
+    std::atomic<std::size_t> m_nbytes_processed = 0;
+    std::atomic<std::size_t> m_nbytes_total = 0;
+};
+
+// Reports the progress of an encoder to an optional encode_progress.
+// Progress is reported when the reporter is created, then every interval bytes of input, and when encoding is finished.
+// In between only a comparison is needed, so update can be called for every item an encoder processes.
+class progress_reporter final
+{
+public:
+    static constexpr std::size_t interval = 64 * 1024;
+
+    progress_reporter(const progress_reporter&) = delete;
+    progress_reporter& operator=(const progress_reporter&) = delete;
+
+    explicit progress_reporter(encode_progress* progress, std::size_t nbytes_total)
+        : m_progress(progress)
+        , m_nbytes_total(nbytes_total)
+    {
+        if (m_progress)
+        {
+            report(0);
+        }
+    }
+
+    void update(std::size_t nbytes_processed)
+    {
+        if (m_progress && (nbytes_processed >= m_next_report))
+        {
+            report(nbytes_processed);
+        }
+    }
+
+    void finish(std::size_t nbytes_processed)
+    {
+        if (m_progress)
+        {
+            m_nbytes_total = nbytes_processed;
+            report(nbytes_processed);
+        }
+    }
+
+    // Checks for cancellation without reporting progress. Unlike update this may be called from worker threads.
+    void throw_if_cancelled() const
+    {
+        if (m_progress)
+        {
+            m_progress->throw_if_cancelled();
+        }
+    }
+
+private:
+    void report(std::size_t nbytes_processed)
+    {
+        m_next_report = nbytes_processed + interval;
+        m_progress->report(nbytes_processed, m_nbytes_total);
+    }
+
+    encode_progress* m_progress;
+    std::size_t m_nbytes_total;
+    std::size_t m_next_report = 0;
+};
+
+// Returns the size of the input if it can be determined without reading the input, 0 otherwise.
+template <std::input_iterator InputIterator>
+std::size_t get_size_if_known([[maybe_unused]] InputIterator input, [[maybe_unused]] InputIterator eof)
+{
+    if constexpr (std::sized_sentinel_for<InputIterator, InputIterator>)
+    {
+        return static_cast<std::size_t>(eof - input);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+// Output iterator which discards the bytes written to it.
+// Decoders use it to validate encoded data without producing any output.
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+class null_output_iterator final
+{
+public:
+    using iterator_category = std::output_iterator_tag;
+    using value_type = void;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = void;
+
+    null_output_iterator& operator=(agbpack_u8) { return *this; }
+
+    null_output_iterator& operator*() { return *this; }
+
+    null_output_iterator& operator++() { return *this; }
+
+    null_output_iterator operator++(int) { return *this; }
+};
+
+// Compares data produced by a decoder against the data that was encoded, byte by byte.
+// This allows encoders to verify their output by decoding it without storing the decoded data.
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+class byte_verifier final
+{
+public:
+    byte_verifier(const byte_verifier&) = delete;
+    byte_verifier& operator=(const byte_verifier&) = delete;
+
+    // Note: byte_verifier does not own expected
+    explicit byte_verifier(std::span<const agbpack_u8> expected)
+        : m_expected(expected)
+    {}
+
+    std::size_t nbytes_verified() const
+    {
+        return m_nbytes_verified;
+    }
+
+    // Returns a byte which has already been verified, offset bytes in front of the next byte to verify.
+    agbpack_u8 verified_byte(std::size_t offset) const
+    {
+        if ((offset == 0) || (offset > m_nbytes_verified))
+        {
+            throw_verification_failed();
+        }
+
+        return m_expected[m_nbytes_verified - offset];
+    }
+
+    void verify8(agbpack_u8 byte)
+    {
+        if ((m_nbytes_verified >= m_expected.size()) || (m_expected[m_nbytes_verified] != byte))
+        {
+            throw_verification_failed();
+        }
+
+        ++m_nbytes_verified;
+    }
+
+    // Checks whether all expected bytes have been verified.
+    void verify_end() const
+    {
+        if (m_nbytes_verified != m_expected.size())
+        {
+            throw_verification_failed();
+        }
+    }
+
+private:
+    [[noreturn]] static void throw_verification_failed()
+    {
+        throw encode_exception("encoded data failed verification");
+    }
+
+    std::span<const agbpack_u8> m_expected;
+    std::size_t m_nbytes_verified = 0;
+};
+
+// Output iterator which passes the bytes written to it to a byte_verifier.
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+class verifying_output_iterator final
+{
+public:
+    using iterator_category = std::output_iterator_tag;
+    using value_type = void;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = void;
+
+    // Note: verifying_output_iterator does not own verifier
+    explicit verifying_output_iterator(byte_verifier& verifier)
+        : m_verifier(&verifier)
+    {}
+
+    verifying_output_iterator& operator=(agbpack_u8 byte)
+    {
+        m_verifier->verify8(byte);
+        return *this;
+    }
+
+    verifying_output_iterator& operator*() { return *this; }
+
+    verifying_output_iterator& operator++() { return *this; }
+
+    verifying_output_iterator operator++(int) { return *this; }
+
+private:
+    byte_verifier* m_verifier;
+};
+
+// Verifies encoded data: decode(verifier) must decode the encoded data and pass the decoded data to verifier.
+// Throws encode_exception if the decoded data differs from expected or if the encoded data cannot be decoded.
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+template <typename F>
+void verify_encoded_data(std::span<const agbpack_u8> expected, F decode)
+{
+    byte_verifier verifier(expected);
+
+    try
+    {
+        decode(verifier);
+    }
+    catch (const decode_exception&)
+    {
+        throw encode_exception("encoded data failed verification");
+    }
+
+    verifier.verify_end();
+}
+
 template <typename InputIterator>
 void static_assert_input_type()
 {
@@ -283,4 +779,22 @@ auto make_signed(UnsignedIntegral value)
     return static_cast<std::make_signed_t<UnsignedIntegral>>(value);
 }
 
+// FNV-1a hash, either 32 or 64 bits wide. Bytes are added one by one using update.
+template <typename Hash>
+requires std::same_as<Hash, agbpack_u32> || std::same_as<Hash, std::uint64_t>
+class fnv1a_hash final
+{
+public:
+    constexpr void update(agbpack_u8 byte)
+    {
+        m_value = (m_value ^ byte) * prime;
+    }
+
+    constexpr Hash value() const { return m_value; }
+
+private:
+    static constexpr Hash prime = (sizeof(Hash) == 4) ? Hash(16777619u) : Hash(1099511628211u);
+    Hash m_value = (sizeof(Hash) == 4) ? Hash(2166136261u) : Hash(14695981039346656037u);
+};
+
 }
@@ -4,7 +4,9 @@
 module;
 
 #include <iterator>
+#include <memory>
 #include <stdexcept>
+#include <utility>
 #include <vector>
 
 export module agbpack:delta;
@@ -19,7 +21,7 @@ export class delta_decoder final
 {
 public:
     template <std::input_iterator InputIterator, typename OutputIterator>
-    void decode(InputIterator input, InputIterator eof, OutputIterator output)
+    decode_result<InputIterator, OutputIterator> decode(InputIterator input, InputIterator eof, OutputIterator output)
     {
         static_assert_input_type<InputIterator>();
 
@@ -32,6 +34,33 @@ public:
 
         byte_writer<OutputIterator> writer(header->uncompressed_size(), output);
         decode8or16(header->template options_as<delta_options>(), reader, writer);
+        return { reader.input(), writer.output() };
+    }
+
+    // Checks whether the input is valid encoded data without producing any output. Throws decode_exception if it is not.
+    // Returns the position following the end of the encoded stream.
+    // Every sequence of deltas is valid, so only the header, the size of the encoded data and the padding need to be checked.
+    template <std::input_iterator InputIterator>
+    InputIterator validate(InputIterator input, InputIterator eof)
+    {
+        static_assert_input_type<InputIterator>();
+
+        byte_reader<InputIterator> reader(input, eof);
+        auto header = header::parse_for_type(compression_type::delta, read32(reader));
+        if (!header)
+        {
+            throw decode_exception();
+        }
+
+        // decode would have to write half a 16 bit value at the end
+        if ((header->template options_as<delta_options>() == delta_options::delta16) && (header->uncompressed_size() % 2))
+        {
+            throw decode_exception();
+        }
+
+        reader.skip(header->uncompressed_size());
+        parse_padding_bytes(reader);
+        return reader.input();
     }
 
 private:
@@ -77,18 +106,22 @@ public:
         {
             static_assert_input_type<InputIterator>();
 
-            // We have to encode to a temporary buffer first, because
-            // * We don't know yet how many bytes of input there are, so we don't know the header content yet
-            // * If the output iterator does not provide random access we cannot output encoded data first and fix up the header last
-            std::vector<agbpack_u8> tmp;
-            auto uncompressed_size = encode8or16(input, eof, back_inserter(tmp));
+            if (!m_verify)
+            {
+                encode_stream(input, eof, output);
+                return;
+            }
 
-            auto header = header::create(m_options, uncompressed_size);
+            const std::vector<agbpack_u8> uncompressed_data(input, eof);
+            std::vector<agbpack_u8> encoded_data;
+            encode_stream(uncompressed_data.begin(), uncompressed_data.end(), back_inserter(encoded_data));
+            verify_encoded_data(uncompressed_data, [&](byte_verifier& verifier)
+            {
+                delta_decoder().decode(encoded_data.begin(), encoded_data.end(), verifying_output_iterator(verifier));
+            });
 
-            // Copy header and encoded data to output
             unbounded_byte_writer<OutputIterator> writer(output);
-            write32(writer, header.to_uint32_t());
-            write(writer, tmp.begin(), tmp.end());
+            write(writer, encoded_data.begin(), encoded_data.end());
         }
         catch (const decode_exception&)
         {
@@ -106,7 +139,47 @@ public:
         m_options = options;
     }
 
+    // Reports progress to progress and allows encoding to be cancelled through it. nullptr disables this.
+    void progress(std::shared_ptr<encode_progress> progress)
+    {
+        m_progress = std::move(progress);
+    }
+
+    const std::shared_ptr<encode_progress>& progress() const
+    {
+        return m_progress;
+    }
+
+    // When verification is enabled, the encoded data is decoded and compared against the input before it is written to output.
+    // If they differ, encode throws encode_exception. Verification needs the input a second time, so the input is buffered.
+    void verify(bool enable)
+    {
+        m_verify = enable;
+    }
+
+    bool verify() const
+    {
+        return m_verify;
+    }
+
 private:
+    template <std::input_iterator InputIterator, typename OutputIterator>
+    void encode_stream(InputIterator input, InputIterator eof, OutputIterator output)
+    {
+        // We have to encode to a temporary buffer first, because
+        // * We don't know yet how many bytes of input there are, so we don't know the header content yet
+        // * If the output iterator does not provide random access we cannot output encoded data first and fix up the header last
+        std::vector<agbpack_u8> tmp;
+        auto uncompressed_size = encode8or16(input, eof, back_inserter(tmp));
+
+        auto header = header::create(m_options, uncompressed_size);
+
+        // Copy header and encoded data to output
+        unbounded_byte_writer<OutputIterator> writer(output);
+        write32(writer, header.to_uint32_t());
+        write(writer, tmp.begin(), tmp.end());
+    }
+
     template <typename InputIterator, std::output_iterator<agbpack_io_datatype> OutputIterator>
     agbpack_u32 encode8or16(InputIterator input, InputIterator eof, OutputIterator output)
     {
@@ -127,12 +200,14 @@ private:
         using symbol_type = typename SizeTag::type;
 
         std::vector<agbpack_u8> encoded_data;
+        progress_reporter reporter(m_progress.get(), get_size_if_known(input, eof));
         byte_reader<InputIterator> reader(input, eof);
         unbounded_byte_writer<OutputIterator> writer(output);
 
         symbol_type old_value = 0;
         while (!reader.eof())
         {
+            reporter.update(reader.nbytes_read());
             symbol_type current_value = read(reader, SizeTag());
             symbol_type delta = current_value - old_value;
             old_value = current_value;
@@ -140,10 +215,13 @@ private:
         }
 
         write_padding_bytes(writer);
+        reporter.finish(reader.nbytes_read());
         return reader.nbytes_read();
     }
 
     delta_options m_options = delta_options::delta8;
+    bool m_verify = false;
+    std::shared_ptr<encode_progress> m_progress;
 };
 
 }
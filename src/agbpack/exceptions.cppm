@@ -39,6 +39,15 @@ public:
     virtual ~encode_exception() override = default;
 };
 
+// Thrown by an encoder when encoding has been cancelled, see encode_progress.
+export class encode_cancelled_exception final : public encode_exception
+{
+public:
+    explicit encode_cancelled_exception() : encode_exception("encoding was cancelled") {}
+
+    virtual ~encode_cancelled_exception() override = default;
+};
+
 export class decode_exception : public agbpack_exception
 {
 public:
@@ -11,11 +11,15 @@ module;
 
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <cassert>
 #include <cstdint>
 #include <iterator>
 #include <memory>
+#include <mutex>
+#include <numeric>
 #include <queue>
+#include <span>
 #include <stdexcept>
 #include <type_traits>
 #include <unordered_map>
@@ -26,6 +30,7 @@ export module agbpack:huffman;
 import :common;
 import :exceptions;
 import :header;
+import :parallel;
 
 namespace agbpack
 {
@@ -179,14 +184,30 @@ public:
 
     void write_code(code c, code_length l)
     {
-        assert(l > 0);
+        assert(in_closed_range(l, 1u, static_cast<code_length>(max_code_length)));
+        assert(((l == max_code_length) || !(c >> l)) && "code has bits set beyond its length");
 
-        code mask = 1 << (l - 1);
-        while (mask)
+        write_bits(c << (max_code_length - l), l);
+    }
+
+    // Writes the nbits most significant bits of bits. The remaining bits must be zero.
+    void write_bits(std::uint32_t bits, unsigned int nbits)
+    {
+        assert((nbits <= 32) && ((nbits == 32) || !(bits << nbits)));
+
+        // Note: std::bit_width returns int or unsigned int, depending on the standard library version
+        const unsigned int nfree = static_cast<unsigned int>(32 - std::countl_zero(m_bitmask));
+        m_bitbuffer |= bits >> (32 - nfree);
+        if (nbits < nfree)
         {
-            write_bit(c & mask);
-            mask >>= 1;
+            m_bitmask >>= nbits;
+            return;
         }
+
+        write32(m_byte_writer, m_bitbuffer);
+        const unsigned int nremaining = nbits - nfree;
+        m_bitbuffer = nremaining ? bits << nfree : 0;
+        m_bitmask = initial_bitmask >> nremaining;
     }
 
     void flush()
@@ -205,54 +226,177 @@ private:
         m_bitmask = initial_bitmask;
     }
 
-    void write_bit(bool bit)
+    bool empty() const
     {
-        if (bit)
+        return m_bitmask == initial_bitmask;
+    }
+
+    static constexpr std::uint32_t initial_bitmask = 0x80000000;
+    unbounded_byte_writer<OutputIterator>& m_byte_writer;
+    std::uint32_t m_bitbuffer;
+    std::uint32_t m_bitmask;
+};
+
+// Buffer for a part of a Huffman bitstream.
+// Uses the same layout as bitstream_writer: codes are filled into 32 bit units, starting with the most significant bit.
+// Parts of a bitstream can thus be encoded independently and be copied to a bitstream_writer afterwards.
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+class huffman_bit_buffer final
+{
+public:
+    void write_code(code c, code_length l)
+    {
+        assert(in_closed_range(l, 1u, static_cast<code_length>(max_code_length)));
+
+        m_pending = (m_pending << l) | (c & ((std::uint64_t(1) << l) - 1));
+        m_npending += l;
+        m_nbits += l;
+
+        if (m_npending >= 32)
         {
-            m_bitbuffer |= m_bitmask;
+            m_npending -= 32;
+            m_words.push_back(static_cast<std::uint32_t>(m_pending >> m_npending));
+            m_pending &= (std::uint64_t(1) << m_npending) - 1;
         }
+    }
 
-        m_bitmask >>= 1;
-
-        if (full())
+    void flush()
+    {
+        if (m_npending)
         {
-            flush();
+            m_words.push_back(static_cast<std::uint32_t>(m_pending << (32 - m_npending)));
+            m_pending = 0;
+            m_npending = 0;
         }
     }
 
-    bool empty() const
+    // Note: call flush before copying the buffer.
+    template <typename OutputIterator>
+    void copy_to(bitstream_writer<OutputIterator>& writer) const
     {
-        return m_bitmask == initial_bitmask;
+        assert(!m_npending && "huffman_bit_buffer has not been flushed");
+
+        size_t nbits = m_nbits;
+        for (auto word : m_words)
+        {
+            const auto n = static_cast<unsigned int>(std::min<size_t>(nbits, 32));
+            writer.write_bits(word, n);
+            nbits -= n;
+        }
     }
 
-    bool full() const
+    size_t nbits() const
     {
-        return m_bitmask == 0;
+        return m_nbits;
     }
 
-    static constexpr std::uint32_t initial_bitmask = 0x80000000;
-    unbounded_byte_writer<OutputIterator>& m_byte_writer;
-    std::uint32_t m_bitbuffer;
-    std::uint32_t m_bitmask;
+private:
+    std::vector<std::uint32_t> m_words;
+    std::uint64_t m_pending = 0;
+    unsigned int m_npending = 0;
+    size_t m_nbits = 0;
 };
 
+// Checks a serialized huffman tree, starting at its root node:
+// * The child nodes of all internal nodes lie within the tree.
+// * All leaf nodes contain valid symbols.
+// * There are no cycles. This holds by construction, since child nodes always come after
+//   their parent node. Nodes may be shared between parents, however, which is why every node
+//   is visited at most once. Otherwise a malicious tree could make us visit exponentially many nodes.
+// Calls visit_internal_node(node_index, child_index) for each node used as internal node.
+// Throws decode_exception if the tree is invalid.
+template <typename Visitor>
+void validate_huffman_tree(unsigned int symbol_size, std::span<const agbpack_u8> serialized_tree, Visitor visit_internal_node)
+{
+    const auto symbol_max_value = get_symbol_mask(symbol_size);
+    std::vector<bool> visited(serialized_tree.size());
+    std::vector<size_t> pending{ static_cast<size_t>(root_node_index) };
+    visited[root_node_index] = true;
+
+    while (!pending.empty())
+    {
+        const auto node_index = pending.back();
+        pending.pop_back();
+
+        const auto node_value = serialized_tree[node_index];
+        const auto child_index = (node_index & ~size_t(1)) + 2u * ((node_value & mask_next_node_offset) + 1);
+        if (child_index + 1 >= serialized_tree.size())
+        {
+            throw decode_exception();
+        }
+
+        for (size_t bit = 0; bit < 2; ++bit)
+        {
+            if (node_value & (bit ? mask1 : mask0))
+            {
+                if (serialized_tree[child_index + bit] > symbol_max_value)
+                {
+                    throw decode_exception("huffman tree contains invalid symbol");
+                }
+            }
+            else if (!visited[child_index + bit])
+            {
+                visited[child_index + bit] = true;
+                pending.push_back(child_index + bit);
+            }
+        }
+
+        visit_internal_node(node_index, child_index);
+    }
+}
+
+// Reads a serialized huffman tree, including the tree size byte.
+template <std::input_iterator InputIterator>
+std::vector<agbpack_u8> read_huffman_tree(byte_reader<InputIterator>& reader)
+{
+    // Read tree size byte and calculate tree size from that.
+    //
+    // Quote from GBATEK: "Size of Tree Table/2-1 (ie. Offset to Compressed Bitstream)"
+    //
+    // Now "size of table" and "offset to bitstream" are two rather different things.
+    // Probably the latter is the correct interpretation, meaning that there might be
+    // padding bytes between the tree data and the bitstream. That in turn would make
+    // sense, since the format seems to be designed such that the bitstream can be
+    // processed in units of 32 bits by an ARM CPU.
+    const auto tree_size_byte = read8(reader);
+    const size_t tree_size = 2u * (tree_size_byte + 1);
+
+    // The address calculations as documented in GBATEK and implemented in decode_symbol
+    // work relative to the address of the tree size byte. It is therefore simplest if we
+    // keep the tree size byte in front of our huffman tree in memory.
+    std::vector<agbpack_u8> serialized_tree{ tree_size_byte };
+
+    // Read huffman tree. Note that the tree size byte counts towards the tree size.
+    // Obviously we have already read the tree size byte, so we need to read one byte
+    // less than the value in tree_size.
+    read8(reader, tree_size - 1, back_inserter(serialized_tree));
+    return serialized_tree;
+}
+
+// Huffman tree as used by the decoder.
+// The tree is validated once when it is created, so decode_symbol
+// and create_code_table can access the tree nodes without checks.
 AGBPACK_EXPORT_FOR_UNIT_TESTING
 template <std::input_iterator InputIterator>
 class huffman_decoder_tree final
 {
 public:
     explicit huffman_decoder_tree(unsigned int symbol_size, byte_reader<InputIterator>& reader)
+        : huffman_decoder_tree(symbol_size, read_huffman_tree(reader))
+    {}
+
+    explicit huffman_decoder_tree(unsigned int symbol_size, std::vector<agbpack_u8> serialized_tree)
         : m_symbol_size(symbol_size)
-        , m_symbol_max_value((1 << symbol_size) - 1u)
+        , m_tree(std::move(serialized_tree))
     {
-        read_tree(reader);
+        validate_huffman_tree(m_symbol_size, m_tree, [](size_t, size_t) {});
     }
 
     agbpack_u8 decode_symbol(bitstream_reader<InputIterator>& bit_reader) const
     {
         bool character_found = false;
         size_t current_node_index = 0;
-        auto current_node_value = read_tree_node(root_node_index);
+        auto current_node_value = m_tree[root_node_index];
 
         while (!character_found)
         {
@@ -261,52 +405,37 @@ public:
             if (!bit_reader.read_bit())
             {
                 character_found = current_node_value & mask0;
-                current_node_value = read_tree_node(current_node_index);
+                current_node_value = m_tree[current_node_index];
             }
             else
             {
                 character_found = current_node_value & mask1;
-                current_node_value = read_tree_node(current_node_index + 1);
+                current_node_value = m_tree[current_node_index + 1];
             }
         }
 
-        throw_if_decoded_symbol_is_invalid(current_node_value);
-
         return current_node_value;
     }
 
     code_table create_code_table() const
     {
         code_table table(m_symbol_size);
-        create_code_table_internal(table, 0, read_tree_node(root_node_index), false, 0, 0);
+        create_code_table_internal(table, 0, m_tree[root_node_index], false, 0, 0);
         return table;
     }
 
-private:
-    void read_tree(byte_reader<InputIterator>& reader)
-    {
-        // Read tree size byte and calculate tree size from that.
-        //
-        // Quote from GBATEK: "Size of Tree Table/2-1 (ie. Offset to Compressed Bitstream)"
-        //
-        // Now "size of table" and "offset to bitstream" are two rather different things.
-        // Probably the latter is the correct interpretation, meaning that there might be
-        // padding bytes between the tree data and the bitstream. That in turn would make
-        // sense, since the format seems to be designed such that the bitstream can be
-        // processed in units of 32 bits by an ARM CPU.
-        size_t tree_size = 2u * (read8(reader) + 1);
-
-        // The address calculations as documented in GBATEK and implemented in decode_symbol
-        // work relative to the address of the tree size byte. It is therefore simplest if we
-        // put a byte in front of our huffman tree in memory. The value of that byte does not matter.
-        m_tree.push_back(0);
-
-        // Read huffman tree. Note that the tree size byte counts towards the tree size.
-        // Obviously we have already read the tree size byte, so we need to read one byte
-        // less than the value in tree_size.
-        read8(reader, tree_size - 1, back_inserter(m_tree));
+    unsigned int symbol_size() const
+    {
+        return m_symbol_size;
+    }
+
+    // The tree as it was read from the encoded data, including the tree size byte.
+    std::span<const agbpack_u8> serialized_tree() const
+    {
+        return m_tree;
     }
 
+private:
     void create_code_table_internal(
         code_table& table,
         size_t node_index,
@@ -317,45 +446,275 @@ private:
     {
         if (is_leaf)
         {
-            throw_if_decoded_symbol_is_invalid(node_value);
             table.set(node_value, c, l);
         }
         else
         {
             node_index += 2u * ((node_value & mask_next_node_offset) + 1);
-            create_code_table_internal(table, node_index, read_tree_node(node_index), node_value & mask0, c << 1, l + 1);
-            create_code_table_internal(table, node_index, read_tree_node(node_index + 1), node_value & mask1, (c << 1) | 1, l + 1);
+            create_code_table_internal(table, node_index, m_tree[node_index], node_value & mask0, c << 1, l + 1);
+            create_code_table_internal(table, node_index, m_tree[node_index + 1], node_value & mask1, (c << 1) | 1, l + 1);
         }
     }
 
-    agbpack_u8 read_tree_node(size_t node_index) const
+    unsigned int m_symbol_size;
+    std::vector<agbpack_u8> m_tree;
+};
+
+// Validated and flattened form of a serialized huffman tree.
+// Like huffman_decoder_tree, but the decoder does not need to compute node addresses.
+// For every node that is used as an internal node, the table holds one entry per child.
+// An entry is either a symbol (flagged with leaf_flag) or the index of the child node.
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+class huffman_decoder_table final
+{
+public:
+    explicit huffman_decoder_table(unsigned int symbol_size, std::span<const agbpack_u8> serialized_tree)
+        : m_symbol_size(symbol_size)
+        , m_nodes(serialized_tree.size())
     {
-        if ((node_index < root_node_index) || (node_index >= m_tree.size()))
+        std::vector<size_t> internal_nodes;
+        validate_huffman_tree(symbol_size, serialized_tree, [this, serialized_tree, &internal_nodes](size_t node_index, size_t child_index)
         {
-            throw decode_exception();
+            const auto node_value = serialized_tree[node_index];
+            for (size_t bit = 0; bit < 2; ++bit)
+            {
+                m_nodes[node_index][bit] = (node_value & (bit ? mask1 : mask0))
+                    ? static_cast<agbpack_u16>(serialized_tree[child_index + bit] | leaf_flag)
+                    : static_cast<agbpack_u16>(child_index + bit);
+            }
+
+            internal_nodes.push_back(node_index);
+        });
+
+        if (symbol_size == 4)
+        {
+            create_transitions(internal_nodes);
+        }
+    }
+
+    unsigned int symbol_size() const
+    {
+        return m_symbol_size;
+    }
+
+    // For 4 bit symbols, the table also holds a state machine which decodes 8 bits of the bitstream at a time.
+    // The states correspond to the internal nodes of the tree, with state 0 being the root node.
+    // Since child pairs can be shared, a tree can have more than 256 internal nodes, hence next_state has 16 bits.
+    // A transition yields up to 8 symbols, packed into a 32 bit word with the first symbol in the least significant bits.
+    struct transition final
+    {
+        std::uint32_t symbols;
+        agbpack_u8 nsymbols;
+        agbpack_u16 next_state;
+    };
+
+    const transition& get_transition(size_t state, agbpack_u8 bits) const
+    {
+        assert((m_symbol_size == 4) && "transitions are only available for 4 bit symbols");
+        return m_transitions[state * 256 + bits];
+    }
+
+    template <std::input_iterator InputIterator>
+    agbpack_u8 decode_symbol(bitstream_reader<InputIterator>& bit_reader) const
+    {
+        auto entry = m_nodes[root_node_index][bit_reader.read_bit()];
+        while (!(entry & leaf_flag))
+        {
+            entry = m_nodes[entry][bit_reader.read_bit()];
         }
 
-        return m_tree[node_index];
+        return static_cast<agbpack_u8>(entry);
     }
 
-    void throw_if_decoded_symbol_is_invalid(agbpack_u8 sym) const
+private:
+    static constexpr agbpack_u16 leaf_flag = 0x8000;
+
+    // Walking 8 bits for each state and each possible input would be relatively expensive,
+    // which matters for small streams. So we first create transitions for 4 bits of input
+    // and then combine two of them into a transition for 8 bits.
+    void create_transitions(const std::vector<size_t>& internal_nodes)
     {
-        if (sym > m_symbol_max_value)
+        std::vector<size_t> states(m_nodes.size());
+        for (size_t state = 0; state < internal_nodes.size(); ++state)
         {
-            throw decode_exception("huffman tree contains invalid symbol");
+            states[internal_nodes[state]] = state;
+        }
+
+        std::vector<transition> nibble_transitions(internal_nodes.size() * 16);
+        for (size_t state = 0; state < internal_nodes.size(); ++state)
+        {
+            for (unsigned int bits = 0; bits < 16; ++bits)
+            {
+                auto& t = nibble_transitions[state * 16 + bits];
+                size_t node_index = internal_nodes[state];
+                for (unsigned int mask = 8; mask; mask >>= 1)
+                {
+                    const auto entry = m_nodes[node_index][(bits & mask) ? 1 : 0];
+                    if (entry & leaf_flag)
+                    {
+                        t.symbols |= std::uint32_t(entry & 15) << (4 * t.nsymbols++);
+                        node_index = root_node_index;
+                    }
+                    else
+                    {
+                        node_index = entry;
+                    }
+                }
+
+                t.next_state = static_cast<agbpack_u16>(states[node_index]);
+            }
+        }
+
+        m_transitions.resize(internal_nodes.size() * 256);
+        for (size_t state = 0; state < internal_nodes.size(); ++state)
+        {
+            for (unsigned int bits = 0; bits < 256; ++bits)
+            {
+                const auto& first = nibble_transitions[state * 16 + (bits >> 4)];
+                const auto& second = nibble_transitions[first.next_state * 16u + (bits & 15)];
+                auto& t = m_transitions[state * 256 + bits];
+                t.symbols = first.symbols | (second.symbols << (4 * first.nsymbols));
+                t.nsymbols = static_cast<agbpack_u8>(first.nsymbols + second.nsymbols);
+                t.next_state = second.next_state;
+            }
         }
     }
 
     unsigned int m_symbol_size;
-    unsigned int m_symbol_max_value;
-    std::vector<agbpack_u8> m_tree;
+    std::vector<std::array<agbpack_u16, 2>> m_nodes;
+    std::vector<transition> m_transitions;
+};
+
+// Cache of huffman decoder tables, keyed by the serialized tree.
+// Decoders sharing a cache only need to validate a tree the first time they encounter it.
+// The cache can be shared between decoders running on different threads.
+// Trees which fail validation are not added to the cache.
+// A table can take up to about a megabyte, so the number of cached tables is limited.
+// When the cache is full, an arbitrary table is evicted to make room for a new one.
+export class huffman_decoder_table_cache final
+{
+public:
+    static constexpr size_t default_maximum_size = 32;
+
+    // Returns the table for the given tree, creating it if it is not in the cache yet.
+    // Throws decode_exception if the tree is invalid.
+    std::shared_ptr<const huffman_decoder_table> get(unsigned int symbol_size, std::span<const agbpack_u8> serialized_tree)
+    {
+        const auto key = hash(symbol_size, serialized_tree);
+
+        {
+            std::lock_guard lock(m_mutex);
+            if (auto table = find(key, symbol_size, serialized_tree))
+            {
+                return table;
+            }
+        }
+
+        // Create the table without holding the lock, so that other threads can
+        // use the cache in the meantime. If another thread has created a table
+        // for the same tree in the meantime, we use that one and drop ours.
+        auto table = std::make_shared<const huffman_decoder_table>(symbol_size, serialized_tree);
+
+        std::lock_guard lock(m_mutex);
+        if (auto existing_table = find(key, symbol_size, serialized_tree))
+        {
+            return existing_table;
+        }
+
+        evict(m_maximum_size - 1);
+        m_entries.emplace(key, cache_entry{ symbol_size, std::vector<agbpack_u8>(serialized_tree.begin(), serialized_tree.end()), table });
+        return table;
+    }
+
+    size_t size() const
+    {
+        std::lock_guard lock(m_mutex);
+        return m_entries.size();
+    }
+
+    // Sets the maximum number of tables in the cache. Must be at least 1.
+    // Tables still in use by a decoder stay alive until the decoder is done with them, even when evicted.
+    void maximum_size(size_t maximum_size)
+    {
+        if (maximum_size == 0)
+        {
+            throw std::invalid_argument("maximum huffman decoder table cache size must be at least 1");
+        }
+
+        std::lock_guard lock(m_mutex);
+        m_maximum_size = maximum_size;
+        evict(m_maximum_size);
+    }
+
+    size_t maximum_size() const
+    {
+        std::lock_guard lock(m_mutex);
+        return m_maximum_size;
+    }
+
+    void clear()
+    {
+        std::lock_guard lock(m_mutex);
+        m_entries.clear();
+    }
+
+private:
+    struct cache_entry final
+    {
+        unsigned int symbol_size;
+        std::vector<agbpack_u8> serialized_tree;
+        std::shared_ptr<const huffman_decoder_table> table;
+    };
+
+    // Since the hash is not collision free, the serialized tree is compared too.
+    std::shared_ptr<const huffman_decoder_table> find(std::uint64_t key, unsigned int symbol_size, std::span<const agbpack_u8> serialized_tree) const
+    {
+        auto [first, last] = m_entries.equal_range(key);
+        for (auto it = first; it != last; ++it)
+        {
+            const auto& entry = it->second;
+            if ((entry.symbol_size == symbol_size) && std::ranges::equal(entry.serialized_tree, serialized_tree))
+            {
+                return entry.table;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // Evicts entries until at most maximum_entries remain. The caller must hold the lock.
+    void evict(size_t maximum_entries)
+    {
+        while (m_entries.size() > maximum_entries)
+        {
+            m_entries.erase(m_entries.begin());
+        }
+    }
+
+    // 64 bit FNV-1a hash of the symbol size and the serialized tree.
+    static std::uint64_t hash(unsigned int symbol_size, std::span<const agbpack_u8> serialized_tree)
+    {
+        assert(symbol_size <= 8);
+        fnv1a_hash<std::uint64_t> h;
+        h.update(static_cast<agbpack_u8>(symbol_size));
+        for (auto byte : serialized_tree)
+        {
+            h.update(byte);
+        }
+
+        return h.value();
+    }
+
+    mutable std::mutex m_mutex;
+    size_t m_maximum_size = default_maximum_size;
+    std::unordered_multimap<std::uint64_t, cache_entry> m_entries;
 };
 
 export class huffman_decoder final
 {
 public:
     template <std::input_iterator InputIterator, typename OutputIterator>
-    void decode(InputIterator input, InputIterator eof, OutputIterator output)
+    decode_result<InputIterator, OutputIterator> decode(InputIterator input, InputIterator eof, OutputIterator output)
     {
         static_assert_input_type<InputIterator>();
 
@@ -367,12 +726,123 @@ public:
         }
 
         const unsigned int symbol_size = get_symbol_size(header->template options_as<huffman_options>());
-        huffman_decoder_tree<InputIterator> tree(symbol_size, reader);
+        auto serialized_tree = read_huffman_tree(reader);
 
         throw_if_bitstream_is_misaligned(reader);
 
+        if (m_table_cache)
+        {
+            const auto table = m_table_cache->get(symbol_size, serialized_tree);
+            output = decode_bitstream(*table, reader, header->uncompressed_size(), output);
+        }
+        else if (symbol_size == 4)
+        {
+            // Creating a table for 4 bit symbols is cheap, and decoding with it is much faster than with the tree.
+            const huffman_decoder_table table(symbol_size, serialized_tree);
+            output = decode_bitstream(table, reader, header->uncompressed_size(), output);
+        }
+        else
+        {
+            const huffman_decoder_tree<InputIterator> tree(symbol_size, std::move(serialized_tree));
+            output = decode_bitstream(tree, reader, header->uncompressed_size(), output);
+        }
+
+        // We already checked whether the bitstream is aligned, and we read it 32 bit wise.
+        // So if at this point we're not 32 bit aligned, then the decoder is broken.
+        assert(((reader.nbytes_read() % 4) == 0) && "huffman_decoder is broken");
+        return { reader.input(), output };
+    }
+
+    // Checks whether the input is valid encoded data without producing any output. Throws decode_exception if it is not.
+    // Returns the position following the end of the encoded stream.
+    // The tree is validated like in decode, using the table cache if there is one. Since the length of the
+    // bitstream depends on the codes it contains, the bitstream still needs to be decoded symbol by symbol.
+    template <std::input_iterator InputIterator>
+    InputIterator validate(InputIterator input, InputIterator eof)
+    {
+        return decode(input, eof, null_output_iterator()).in;
+    }
+
+    // Sets the cache from which decoder tables are taken.
+    // With a cache, each distinct tree is validated only once, when it is added to the cache.
+    // Without a cache (the default), the tree is validated for every decoded stream.
+    void table_cache(std::shared_ptr<huffman_decoder_table_cache> cache)
+    {
+        m_table_cache = std::move(cache);
+    }
+
+    const std::shared_ptr<huffman_decoder_table_cache>& table_cache() const
+    {
+        return m_table_cache;
+    }
+
+private:
+    template <std::input_iterator InputIterator, typename OutputIterator>
+    static OutputIterator decode_bitstream(const huffman_decoder_table& table, byte_reader<InputIterator>& reader, agbpack_u32 uncompressed_size, OutputIterator output)
+    {
+        if (table.symbol_size() == 4)
+        {
+            return decode_nibbles(table, reader, uncompressed_size, output);
+        }
+        else
+        {
+            return decode_symbols(table, reader, uncompressed_size, output);
+        }
+    }
+
+    template <std::input_iterator InputIterator, typename OutputIterator>
+    static OutputIterator decode_bitstream(const huffman_decoder_tree<InputIterator>& tree, byte_reader<InputIterator>& reader, agbpack_u32 uncompressed_size, OutputIterator output)
+    {
+        return decode_symbols(tree, reader, uncompressed_size, output);
+    }
+
+    // Decodes 4 bit symbols using the table's state machine, one byte of the bitstream at a time.
+    // The bitstream is read in units of 32 bits, so no bits are read past the last unit needed.
+    // Symbols decoded from padding bits at the end of the last unit are ignored.
+    template <std::input_iterator InputIterator, typename OutputIterator>
+    static OutputIterator decode_nibbles(const huffman_decoder_table& table, byte_reader<InputIterator>& reader, agbpack_u32 uncompressed_size, OutputIterator output)
+    {
+        byte_writer<OutputIterator> writer(uncompressed_size, output);
+        size_t state = 0;
+        unsigned int pending_symbol = 0;
+        bool have_pending_symbol = false;
+
+        while (!writer.done())
+        {
+            auto bitbuffer = read32(reader);
+            for (int i = 0; (i < 4) && !writer.done(); ++i)
+            {
+                const auto& t = table.get_transition(state, static_cast<agbpack_u8>(bitbuffer >> 24));
+                bitbuffer <<= 8;
+                state = t.next_state;
+
+                auto symbols = t.symbols;
+                for (unsigned int n = 0; (n < t.nsymbols) && !writer.done(); ++n)
+                {
+                    if (have_pending_symbol)
+                    {
+                        write8(writer, static_cast<agbpack_u8>(pending_symbol | ((symbols & 15) << 4)));
+                    }
+                    else
+                    {
+                        pending_symbol = symbols & 15;
+                    }
+
+                    have_pending_symbol = !have_pending_symbol;
+                    symbols >>= 4;
+                }
+            }
+        }
+
+        return writer.output();
+    }
+
+    template <typename Tree, std::input_iterator InputIterator, typename OutputIterator>
+    static OutputIterator decode_symbols(const Tree& tree, byte_reader<InputIterator>& reader, agbpack_u32 uncompressed_size, OutputIterator output)
+    {
+        const auto symbol_size = tree.symbol_size();
         bitstream_reader<InputIterator> bit_reader(reader);
-        byte_writer<OutputIterator> writer(header->uncompressed_size(), output);
+        byte_writer<OutputIterator> writer(uncompressed_size, output);
 
         while (!writer.done())
         {
@@ -385,12 +855,9 @@ public:
             write8(writer, decoded_byte);
         }
 
-        // We already checked whether the bitstream is aligned, and we read it 32 bit wise.
-        // So if at this point we're not 32 bit aligned, then the decoder is broken.
-        assert(((reader.nbytes_read() % 4) == 0) && "huffman_decoder is broken");
+        return writer.output();
     }
 
-private:
     template <std::input_iterator InputIterator>
     static void throw_if_bitstream_is_misaligned(const byte_reader<InputIterator>& reader)
     {
@@ -399,6 +866,8 @@ private:
             throw decode_exception("bitstream is misaligned");
         }
     }
+
+    std::shared_ptr<huffman_decoder_table_cache> m_table_cache;
 };
 
 AGBPACK_EXPORT_FOR_UNIT_TESTING
@@ -410,27 +879,61 @@ public:
         , m_frequencies(get_nsymbols(symbol_size))
     {}
 
-    template <std::input_iterator InputIterator>
-    std::vector<agbpack_u8> update(InputIterator input, InputIterator eof)
+    // Counts the symbols in the input.
+    // With a single histogram, runs of the same byte would make each increment wait for the previous one
+    // to complete. Bytes are therefore counted into interleaved histograms which are merged at the end.
+    // For 4 bit symbols the merged byte histogram is then split into nibble frequencies.
+    void update(std::span<const agbpack_u8> data)
     {
-        std::vector<agbpack_u8> data;
-        byte_reader<InputIterator> reader(input, eof);
-        auto symbol_mask = get_symbol_mask(m_symbol_size);
+        std::array<std::array<symbol_frequency, 256>, 4> histograms{};
+
+        size_t i = 0;
+        for (; data.size() - i >= histograms.size(); i += histograms.size())
+        {
+            ++histograms[0][data[i]];
+            ++histograms[1][data[i + 1]];
+            ++histograms[2][data[i + 2]];
+            ++histograms[3][data[i + 3]];
+        }
 
-        while (!reader.eof())
+        for (; i < data.size(); ++i)
         {
-            auto byte = reader.read8();
-            data.push_back(byte);
+            ++histograms[0][data[i]];
+        }
 
+        auto symbol_mask = get_symbol_mask(m_symbol_size);
+        for (unsigned int byte = 0; byte < 256; ++byte)
+        {
+            const auto count = histograms[0][byte] + histograms[1][byte] + histograms[2][byte] + histograms[3][byte];
             for (unsigned int nbits = 0; nbits < 8; nbits += m_symbol_size)
             {
-                auto sym = byte & symbol_mask;
-                ++m_frequencies[sym];
-                byte >>= m_symbol_size;
+                m_frequencies[(byte >> nbits) & symbol_mask] += count;
             }
         }
+    }
+
+    // Returns the frequencies of 4 bit symbols, given the frequencies of 8 bit symbols.
+    frequency_table split_into_nibbles() const
+    {
+        assert(m_symbol_size == 8);
+        frequency_table nibble_frequencies(4);
+        for (symbol byte = 0; byte < 256; ++byte)
+        {
+            nibble_frequencies.m_frequencies[byte & 15] += m_frequencies[byte];
+            nibble_frequencies.m_frequencies[byte >> 4] += m_frequencies[byte];
+        }
 
-        return data;
+        return nibble_frequencies;
+    }
+
+    // Adds the frequencies counted by another frequency table with the same symbol size.
+    void add(const frequency_table& other)
+    {
+        assert(m_symbol_size == other.m_symbol_size);
+        for (size_t i = 0; i < m_frequencies.size(); ++i)
+        {
+            m_frequencies[i] += other.m_frequencies[i];
+        }
     }
 
     symbol_frequency frequency(symbol s) const
@@ -964,38 +1467,198 @@ private:
     offset_map m_offset;
 };
 
-export class huffman_encoder final
+// Result of comparing the size of data encoded with a shared tree and with a tree of its own.
+export struct huffman_size_comparison final
+{
+    size_t own_tree_encoded_size = 0;
+    size_t shared_tree_encoded_size = 0;
+};
+
+export class huffman_corpus;
+export class huffman_encoder;
+
+// Returns the size of encoded data, including header, serialized tree and bitstream.
+inline size_t get_encoded_size(const frequency_table& ftable, const code_table& code_table, size_t serialized_tree_size)
+{
+    // Uncompressed data is limited to 2^24 bytes, so the number of bits fits into size_t
+    size_t nbits = 0;
+    for (symbol sym = 0; sym < get_nsymbols(code_table.symbol_size()); ++sym)
+    {
+        nbits += size_t{ ftable.frequency(sym) } * code_table[sym].l();
+    }
+
+    return header_size + serialized_tree_size + 4 * ((nbits + 31) / 32);
+}
+
+// Huffman tree shared by a family of similar data. Created by huffman_corpus.
+// Encoding with a shared tree skips counting symbols and building and serializing a tree.
+// Since the GBA BIOS expects the tree in each stream, the shared tree is still written to each stream.
+// Every symbol has a code, so the tree can encode any data, not just the data of the corpus it was built from.
+export class huffman_shared_tree final
 {
 public:
-    template <std::input_iterator InputIterator, typename OutputIterator>
-    void encode(InputIterator input, InputIterator eof, OutputIterator output)
+    huffman_options options() const { return m_options; }
+
+    const std::vector<agbpack_u8>& serialized_tree() const { return m_serialized_tree; }
+
+    // Compares the size of the data encoded with this tree and with a tree of its own.
+    template <std::input_iterator InputIterator>
+    huffman_size_comparison compare(InputIterator input, InputIterator eof) const
     {
         static_assert_input_type<InputIterator>();
 
-        const unsigned int symbol_size = get_symbol_size(m_options);
+        const std::vector<agbpack_u8> data(input, eof);
+        const auto symbol_size = get_symbol_size(m_options);
+        frequency_table ftable(symbol_size);
+        ftable.update(data);
+
+        const huffman_encoder_tree own_tree(symbol_size, ftable);
+        const auto own_serialized_tree = huffman_tree_serializer().serialize(own_tree);
+
+        huffman_size_comparison result;
+        result.own_tree_encoded_size = get_encoded_size(ftable, own_tree.create_code_table(), own_serialized_tree.size());
+        result.shared_tree_encoded_size = get_encoded_size(ftable, m_code_table, m_serialized_tree.size());
+        return result;
+    }
+
+private:
+    friend class huffman_corpus;
+    friend class huffman_encoder;
+
+    explicit huffman_shared_tree(huffman_options options, const frequency_table& ftable)
+        : m_options(options)
+        , m_code_table(get_symbol_size(options))
+    {
+        const huffman_encoder_tree tree(get_symbol_size(options), ftable);
+        m_serialized_tree = huffman_tree_serializer().serialize(tree);
+        m_code_table = tree.create_code_table();
+    }
+
+    const code_table& get_code_table() const { return m_code_table; }
+
+    huffman_options m_options;
+    std::vector<agbpack_u8> m_serialized_tree;
+    code_table m_code_table;
+};
+
+// Statistics collected by huffman_encoder.
+export struct huffman_encoder_statistics final
+{
+    // Options used for encoding. With automatic options, these are the options selected by the encoder.
+    huffman_options options = huffman_options::h8;
+
+    // Size of the serialized tree in bytes, including the tree size byte and padding.
+    size_t tree_size = 0;
+
+    // Number of encoded symbols by code length. The index is the code length.
+    std::array<size_t, max_code_length + 1> code_length_histogram{};
+
+    std::vector<encoder_phase_time> phase_times;
+};
+
+// Collects symbol frequencies of a family of similar data and creates a shared tree from them.
+export class huffman_corpus final
+{
+public:
+    explicit huffman_corpus(huffman_options options = huffman_options::h8)
+        : m_options(options)
+        , m_frequencies(get_nsymbols(get_symbol_size(options)))
+    {
+        if (!is_valid(options))
+        {
+            throw std::invalid_argument("invalid huffman compression options");
+        }
+    }
+
+    huffman_options options() const { return m_options; }
+
+    template <std::input_iterator InputIterator>
+    void add(InputIterator input, InputIterator eof)
+    {
+        static_assert_input_type<InputIterator>();
+
+        frequency_table ftable(get_symbol_size(m_options));
+        if constexpr (std::contiguous_iterator<InputIterator>)
+        {
+            ftable.update(std::span<const agbpack_u8>(std::to_address(input), std::to_address(eof)));
+        }
+        else
+        {
+            ftable.update(std::vector<agbpack_u8>(input, eof));
+        }
+
+        for (symbol sym = 0; sym < m_frequencies.size(); ++sym)
+        {
+            m_frequencies[sym] += ftable.frequency(sym);
+        }
+    }
+
+    // Creates a shared tree from the frequencies of all data added so far.
+    // Symbols which do not occur in the corpus are given the lowest possible frequency, so that they get a code too.
+    // Frequencies of big corpora are scaled down to the range the encoder handles for data of maximum size.
+    huffman_shared_tree create_tree() const
+    {
+        const auto symbol_size = get_symbol_size(m_options);
+        const std::uint64_t maximum_total_frequency = std::uint64_t(maximum_uncompressed_size) * (8 / symbol_size);
+
+        auto frequencies = m_frequencies;
+        for (auto& f : frequencies)
+        {
+            f = std::max<std::uint64_t>(f, 1);
+        }
+
+        while (std::accumulate(frequencies.begin(), frequencies.end(), std::uint64_t(0)) > maximum_total_frequency)
+        {
+            for (auto& f : frequencies)
+            {
+                f = std::max<std::uint64_t>(f / 2, 1);
+            }
+        }
 
-        // Create frequency table.
-        // We need to re-read the input during encoding, so we also create a buffer with the input.
         frequency_table ftable(symbol_size);
-        const auto uncompressed_data = ftable.update(input, eof);
+        for (symbol sym = 0; sym < frequencies.size(); ++sym)
+        {
+            ftable.set_frequency(sym, static_cast<symbol_frequency>(frequencies[sym]));
+        }
 
-        // Create header.
-        // This throws if uncompressed data is to big, which we want
-        // to happen before we spend time on tree serialization.
-        auto header = header::create(m_options, uncompressed_data.size());
+        return huffman_shared_tree(m_options, ftable);
+    }
 
-        // Create the tree for the encoder.
-        // Also create the serialized variant of the tree and the code table for the encoder.
-        huffman_encoder_tree tree(symbol_size, ftable);
-        huffman_tree_serializer serializer;
-        const auto serialized_tree = serializer.serialize(tree);
-        const auto code_table = tree.create_code_table();
+private:
+    huffman_options m_options;
+    std::vector<std::uint64_t> m_frequencies;
+};
 
-        // Copy header and tree to output, then encode data directly to output.
-        unbounded_byte_writer<OutputIterator> writer(output);
-        write32(writer, header.to_uint32_t());
-        write(writer, serialized_tree.begin(), serialized_tree.end());
-        encode_internal(code_table, uncompressed_data, writer);
+export class huffman_encoder final
+{
+public:
+    template <std::input_iterator InputIterator, typename OutputIterator>
+    void encode(InputIterator input, InputIterator eof, OutputIterator output)
+    {
+        encode(input, eof, output, nullptr);
+    }
+
+    // Encodes using a shared tree rather than creating a tree for the input.
+    // The shared tree must have been created for the options of the encoder, unless automatic options
+    // are enabled, in which case the input is encoded with the options of the shared tree.
+    template <std::input_iterator InputIterator, typename OutputIterator>
+    void encode(InputIterator input, InputIterator eof, OutputIterator output, const huffman_shared_tree& shared_tree)
+    {
+        if (!m_automatic_options && (shared_tree.options() != m_options))
+        {
+            throw std::invalid_argument("shared tree was created for different huffman compression options");
+        }
+
+        encode(input, eof, output, &shared_tree);
+    }
+
+    // Encodes data and collects statistics about the encoded data.
+    // The encoded data is the same as without statistics.
+    template <std::input_iterator InputIterator, typename OutputIterator>
+    void encode(InputIterator input, InputIterator eof, OutputIterator output, huffman_encoder_statistics& statistics)
+    {
+        statistics = {};
+        encode(input, eof, output, nullptr, statistics);
     }
 
     void options(huffman_options options)
@@ -1008,30 +1671,314 @@ public:
         m_options = options;
     }
 
+    // Selects the symbol size automatically: the input is encoded with whichever of
+    // 4 bit and 8 bit symbols produces the smaller output. If both produce output of
+    // the same size, 8 bit symbols are used, since they decode faster.
+    // When encoding with a shared tree the symbol size is that of the tree.
+    void automatic_options(bool enable)
+    {
+        m_automatic_options = enable;
+    }
+
+    bool automatic_options() const
+    {
+        return m_automatic_options;
+    }
+
+    // Number of threads to use. 0 means one thread per hardware thread.
+    // With more than one thread, big inputs are split into chunks whose symbols are counted and
+    // encoded on separate threads. The encoded data is the same as with a single thread.
+    void nthreads(unsigned int nthreads)
+    {
+        m_nthreads = nthreads;
+    }
+
+    unsigned int nthreads() const
+    {
+        return m_nthreads;
+    }
+
+    // Reports progress to progress and allows encoding to be cancelled through it. nullptr disables this.
+    // Progress is reported while the encoded data is written. Counting symbols only checks whether encoding has been cancelled.
+    void progress(std::shared_ptr<encode_progress> progress)
+    {
+        m_progress = std::move(progress);
+    }
+
+    const std::shared_ptr<encode_progress>& progress() const
+    {
+        return m_progress;
+    }
+
+    // When verification is enabled, the encoded data is decoded and compared against the input before it is written to output.
+    // If they differ, encode throws encode_exception. Without verification the encoded data is written directly to output.
+    void verify(bool enable)
+    {
+        m_verify = enable;
+    }
+
+    bool verify() const
+    {
+        return m_verify;
+    }
+
 private:
+    static constexpr size_t minimum_chunk_size = 256 * 1024;
+
+    template <std::input_iterator InputIterator, typename OutputIterator>
+    void encode(InputIterator input, InputIterator eof, OutputIterator output, const huffman_shared_tree* shared_tree)
+    {
+        no_statistics statistics;
+        encode(input, eof, output, shared_tree, statistics);
+    }
+
+    template <std::input_iterator InputIterator, typename OutputIterator, typename Statistics>
+    void encode(InputIterator input, InputIterator eof, OutputIterator output, const huffman_shared_tree* shared_tree, Statistics& statistics)
+    {
+        static_assert_input_type<InputIterator>();
+
+        // We need to read the input twice: once to count symbols and once to encode them.
+        // Contiguous input can be read directly, for any other input we create a buffer with the input.
+        if constexpr (std::contiguous_iterator<InputIterator>)
+        {
+            encode_and_verify(std::span<const agbpack_u8>(std::to_address(input), std::to_address(eof)), output, shared_tree, statistics);
+        }
+        else
+        {
+            const std::vector<agbpack_u8> uncompressed_data(input, eof);
+            encode_and_verify(uncompressed_data, output, shared_tree, statistics);
+        }
+    }
+
+    template <typename OutputIterator, typename Statistics>
+    void encode_and_verify(std::span<const agbpack_u8> uncompressed_data, OutputIterator output, const huffman_shared_tree* shared_tree, Statistics& statistics)
+    {
+        if (!m_verify)
+        {
+            encode_internal(uncompressed_data, output, shared_tree, statistics);
+            return;
+        }
+
+        std::vector<agbpack_u8> encoded_data;
+        encode_internal(uncompressed_data, back_inserter(encoded_data), shared_tree, statistics);
+        measure_phase(statistics, "verify", [&]()
+        {
+            verify_encoded_data(uncompressed_data, [&](byte_verifier& verifier)
+            {
+                huffman_decoder().decode(encoded_data.begin(), encoded_data.end(), verifying_output_iterator(verifier));
+            });
+        });
+
+        unbounded_byte_writer<OutputIterator> writer(output);
+        write(writer, encoded_data.begin(), encoded_data.end());
+    }
+
+    template <typename OutputIterator, typename Statistics>
+    void encode_internal(std::span<const agbpack_u8> uncompressed_data, OutputIterator output, const huffman_shared_tree* shared_tree, Statistics& statistics)
+    {
+        const unsigned int symbol_size = get_symbol_size(m_options);
+
+        // Create header.
+        // This throws if uncompressed data is to big, which we want
+        // to happen before we spend time on counting symbols and tree serialization.
+        auto header = header::create(shared_tree ? shared_tree->options() : m_options, uncompressed_data.size());
+        const auto chunks = split_into_chunks(uncompressed_data);
+        progress_reporter reporter(m_progress.get(), uncompressed_data.size());
+
+        if (shared_tree)
+        {
+            measure_phase(statistics, "emit", [&]() { write_stream(header, shared_tree->serialized_tree(), shared_tree->get_code_table(), chunks, output, reporter); });
+            return;
+        }
+
+        if (!m_automatic_options)
+        {
+            const auto ftable = measure_phase(statistics, "frequency", [&]() { return count_symbols(symbol_size, chunks, reporter); });
+            const auto tree = create_tree(m_options, ftable, statistics);
+            record_tree(tree, ftable, statistics);
+            measure_phase(statistics, "emit", [&]() { write_stream(header, tree.serialized_tree, tree.code_table, chunks, output, reporter); });
+            return;
+        }
+
+        // Try both symbol sizes. The nibble frequencies can be derived from the byte frequencies,
+        // so the input needs to be counted only once.
+        // Note that there is no point in trying different layouts of the serialized tree:
+        // a tree with n leaves always serializes to 2n bytes, plus padding.
+        const auto byte_frequencies = measure_phase(statistics, "frequency", [&]() { return count_symbols(8, chunks, reporter); });
+        const auto nibble_frequencies = byte_frequencies.split_into_nibbles();
+        const auto h8_tree = create_tree(huffman_options::h8, byte_frequencies, statistics);
+        const auto h4_tree = create_tree(huffman_options::h4, nibble_frequencies, statistics);
+        const bool use_h4 = h4_tree.encoded_size < h8_tree.encoded_size;
+        const auto& tree = use_h4 ? h4_tree : h8_tree;
+        record_tree(tree, use_h4 ? nibble_frequencies : byte_frequencies, statistics);
+        measure_phase(statistics, "emit", [&]() { write_stream(header::create(tree.options, uncompressed_data.size()), tree.serialized_tree, tree.code_table, chunks, output, reporter); });
+    }
+
+    // The tree created for some input, in the forms needed by the encoder.
+    struct encoder_tree_data final
+    {
+        huffman_options options;
+        std::vector<agbpack_u8> serialized_tree;
+        agbpack::code_table code_table;
+        size_t encoded_size;
+    };
+
+    template <typename Statistics>
+    static encoder_tree_data create_tree(huffman_options options, const frequency_table& ftable, Statistics& statistics)
+    {
+        const auto symbol_size = get_symbol_size(options);
+        const auto tree = measure_phase(statistics, "tree build", [&]() { return huffman_encoder_tree(symbol_size, ftable); });
+        auto serialized_tree = measure_phase(statistics, "serialize", [&]() { return huffman_tree_serializer().serialize(tree); });
+        auto code_table = tree.create_code_table();
+        const auto encoded_size = get_encoded_size(ftable, code_table, serialized_tree.size());
+        return { options, std::move(serialized_tree), std::move(code_table), encoded_size };
+    }
+
+    template <typename Statistics>
+    static void record_tree([[maybe_unused]] const encoder_tree_data& tree, [[maybe_unused]] const frequency_table& ftable, [[maybe_unused]] Statistics& statistics)
+    {
+        if constexpr (collects_statistics<Statistics>)
+        {
+            statistics.options = tree.options;
+            statistics.tree_size = tree.serialized_tree.size();
+            for (symbol sym = 0; sym < get_nsymbols(get_symbol_size(tree.options)); ++sym)
+            {
+                statistics.code_length_histogram[tree.code_table[sym].l()] += ftable.frequency(sym);
+            }
+        }
+    }
+
     template <typename OutputIterator>
-    static void encode_internal(
+    void write_stream(
+        const header& header,
+        const std::vector<agbpack_u8>& serialized_tree,
         const code_table& code_table,
-        const std::vector<agbpack_u8>& uncompressed_data,
-        unbounded_byte_writer<OutputIterator>& writer)
+        const std::vector<std::span<const agbpack_u8>>& chunks,
+        OutputIterator output,
+        progress_reporter& reporter) const
     {
-        auto symbol_size = code_table.symbol_size();
-        auto symbol_mask = get_symbol_mask(symbol_size);
+        // Copy header and tree to output, then encode data directly to output.
+        unbounded_byte_writer<OutputIterator> writer(output);
         bitstream_writer<OutputIterator> bit_writer(writer);
-
-        for (auto byte : uncompressed_data)
+        write32(writer, header.to_uint32_t());
+        write(writer, serialized_tree.begin(), serialized_tree.end());
+        const auto byte_code_table = create_byte_code_table(code_table);
+        if (chunks.size() == 1)
         {
-            for (unsigned int nbits = 0; nbits < 8; nbits += symbol_size)
+            // Encode in pieces so that progress can be reported in between
+            for (size_t offset = 0; offset < chunks[0].size(); offset += progress_reporter::interval)
             {
-                symbol sym = byte & symbol_mask;
-                bit_writer.write_code(code_table[sym].c(), code_table[sym].l());
-                byte >>= symbol_size;
+                reporter.update(offset);
+                encode_bytes(byte_code_table, chunks[0].subspan(offset, std::min(progress_reporter::interval, chunks[0].size() - offset)), bit_writer);
             }
         }
+        else
+        {
+            encode_chunks(byte_code_table, chunks, bit_writer, reporter);
+        }
         bit_writer.flush();
+        reporter.finish(get_size(chunks));
+    }
+
+    static size_t get_size(const std::vector<std::span<const agbpack_u8>>& chunks)
+    {
+        return std::accumulate(chunks.begin(), chunks.end(), size_t(0), [](size_t size, const auto& chunk) { return size + chunk.size(); });
+    }
+
+    // Creates a table with a code for each byte, so that the encoder can process whole bytes regardless of symbol size.
+    // For 4 bit symbols, the code of a byte is the code of its low nibble followed by the code of its high nibble.
+    // Since codes of 4 bit symbols are at most 15 bits long, the combined codes are at most 30 bits long.
+    static agbpack::code_table create_byte_code_table(const agbpack::code_table& code_table)
+    {
+        if (code_table.symbol_size() == 8)
+        {
+            return code_table;
+        }
+
+        agbpack::code_table byte_code_table(8);
+        for (symbol byte = 0; byte < 256; ++byte)
+        {
+            const auto& low = code_table[byte & 15];
+            const auto& high = code_table[byte >> 4];
+            byte_code_table.set(byte, (low.c() << high.l()) | high.c(), low.l() + high.l());
+        }
+
+        return byte_code_table;
+    }
+
+    std::vector<std::span<const agbpack_u8>> split_into_chunks(std::span<const agbpack_u8> data) const
+    {
+        const auto nchunks = std::max<size_t>(std::min<size_t>(get_nthreads(m_nthreads), data.size() / minimum_chunk_size), 1);
+        const auto chunk_size = (data.size() + nchunks - 1) / nchunks;
+
+        std::vector<std::span<const agbpack_u8>> chunks;
+        for (size_t offset = 0; offset < data.size(); offset += chunk_size)
+        {
+            chunks.push_back(data.subspan(offset, std::min(chunk_size, data.size() - offset)));
+        }
+
+        if (chunks.empty())
+        {
+            chunks.push_back(data);
+        }
+
+        return chunks;
+    }
+
+    frequency_table count_symbols(unsigned int symbol_size, const std::vector<std::span<const agbpack_u8>>& chunks, const progress_reporter& reporter) const
+    {
+        std::vector<frequency_table> ftables(chunks.size(), frequency_table(symbol_size));
+        run_in_parallel(chunks.size(), m_nthreads, [&](size_t i)
+        {
+            reporter.throw_if_cancelled();
+            ftables[i].update(chunks[i]);
+        });
+
+        for (size_t i = 1; i < ftables.size(); ++i)
+        {
+            ftables[0].add(ftables[i]);
+        }
+
+        return ftables[0];
+    }
+
+    // Encodes each chunk into a separate buffer, then stitches the buffers together.
+    template <typename OutputIterator>
+    void encode_chunks(
+        const code_table& byte_code_table,
+        const std::vector<std::span<const agbpack_u8>>& chunks,
+        bitstream_writer<OutputIterator>& bit_writer,
+        const progress_reporter& reporter) const
+    {
+        std::vector<huffman_bit_buffer> buffers(chunks.size());
+        run_in_parallel(chunks.size(), m_nthreads, [&](size_t i)
+        {
+            reporter.throw_if_cancelled();
+            encode_bytes(byte_code_table, chunks[i], buffers[i]);
+            buffers[i].flush();
+        });
+
+        for (const auto& buffer : buffers)
+        {
+            buffer.copy_to(bit_writer);
+        }
+    }
+
+    template <typename BitWriter>
+    static void encode_bytes(const code_table& byte_code_table, std::span<const agbpack_u8> uncompressed_data, BitWriter& bit_writer)
+    {
+        for (auto byte : uncompressed_data)
+        {
+            const auto& entry = byte_code_table[byte];
+            bit_writer.write_code(entry.c(), entry.l());
+        }
     }
 
     huffman_options m_options = huffman_options::h8;
+    bool m_automatic_options = false;
+    unsigned int m_nthreads = 1;
+    bool m_verify = false;
+    std::shared_ptr<encode_progress> m_progress;
 };
 
 }
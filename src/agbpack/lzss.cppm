@@ -5,20 +5,35 @@ module;
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <bit>
 #include <cassert>
+#include <chrono>
 #include <concepts>
 #include <cstddef>
+#include <cstring>
+#include <exception>
 #include <iterator>
+#include <limits>
+#include <memory>
 #include <ranges>
+#include <span>
+#include <stdexcept>
+#include <thread>
 #include <utility>
 #include <vector>
 #include "clownlzss.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define AGBPACK_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
 export module agbpack:lzss;
 import :common;
 import :exceptions;
 import :header;
+import :parallel;
 
 namespace agbpack
 {
@@ -44,6 +59,13 @@ constexpr size_t get_minimum_offset(bool vram_safe)
     return vram_safe ? minimum_vram_safe_offset : minimum_offset;
 }
 
+// Returns the number of bits needed to represent an offset.
+// Note: unlike std::bit_width, the result type does not depend on the standard library version.
+constexpr size_t get_bit_width(size_t offset)
+{
+    return static_cast<size_t>(std::numeric_limits<size_t>::digits - std::countl_zero(offset));
+}
+
 // Sliding window for LZSS decoder. Used when the output iterator does not allow random access.
 // * Maintains an internal write position which wraps around when the window is written to.
 // * Allows reading relative to the write position. The final read position wraps around.
@@ -118,6 +140,11 @@ public:
         }
     }
 
+    OutputIterator output() const
+    {
+        return m_writer.output();
+    }
+
 private:
     void write8(agbpack_u8 byte)
     {
@@ -155,6 +182,11 @@ public:
         }
     }
 
+    RandomAccessIterator output() const
+    {
+        return m_output;
+    }
+
 private:
     void write8(agbpack_u8 byte)
     {
@@ -164,11 +196,202 @@ private:
     RandomAccessIterator m_output;
 };
 
+// LZSS decoder output receiver for decoding a range of the uncompressed data.
+// Maintains a sliding window which can be primed with the data preceding a checkpoint.
+// Only passes the requested range of the uncompressed data on to the output iterator.
+template <typename OutputIterator>
+class lzss_range_receiver final
+{
+public:
+    explicit lzss_range_receiver(size_t uncompressed_size, size_t position, size_t begin, size_t end, OutputIterator output)
+        : m_writer(uncompressed_size, position, begin, end, output)
+    {}
+
+    void prime(std::span<const agbpack_u8> window)
+    {
+        for (auto byte : window)
+        {
+            m_window.write8(byte);
+        }
+    }
+
+    void tags(agbpack_u8) {}
+
+    void literal(agbpack_u8 literal)
+    {
+        write8(literal);
+    }
+
+    void reference(size_t length, size_t offset)
+    {
+        while (length--)
+        {
+            auto byte = m_window.read8(offset);
+            write8(byte);
+        }
+    }
+
+    OutputIterator output() const
+    {
+        return m_writer.output();
+    }
+
+private:
+    void write8(agbpack_u8 byte)
+    {
+        m_writer.write8(byte);
+        m_window.write8(byte);
+    }
+
+    byte_range_writer<OutputIterator> m_writer;
+    lzss_sliding_window<maximum_offset> m_window;
+};
+
+// Statistics about LZSS encoded data, collected by lzss_profiling_receiver.
+export struct lzss_decoder_statistics final
+{
+    // Number of bytes of uncompressed data.
+    size_t nbytes = 0;
+
+    size_t ntag_bytes = 0;
+    size_t nliterals = 0;
+    size_t nreferences = 0;
+
+    // Number of references by length. The index is the match length.
+    std::array<size_t, maximum_match_length + 1> match_length_histogram{};
+
+    // Number of references by offset. The index is the bit width of the offset, see lzss_encoder_statistics.
+    std::array<size_t, get_bit_width(maximum_offset) + 1> match_offset_histogram{};
+
+    // Number of references which cannot be decoded by the GBA BIOS when writing to VRAM.
+    size_t nvram_unsafe_references = 0;
+};
+
+// LZSS decoder receiver which does not produce any output but collects statistics.
+// Receivers are passed by value, so the statistics are written to an object owned by the caller.
+// References which are not VRAM safe are counted rather than rejected, unless the decoder itself
+// is configured to be VRAM safe.
+export class lzss_profiling_receiver final
+{
+public:
+    explicit lzss_profiling_receiver(lzss_decoder_statistics& statistics)
+        : m_statistics(&statistics)
+    {
+        *m_statistics = {};
+    }
+
+    void tags(agbpack_u8)
+    {
+        ++m_statistics->ntag_bytes;
+    }
+
+    void literal(agbpack_u8)
+    {
+        ++m_statistics->nliterals;
+        ++m_statistics->nbytes;
+    }
+
+    void reference(size_t length, size_t offset)
+    {
+        ++m_statistics->nreferences;
+        ++m_statistics->match_length_histogram[length];
+        ++m_statistics->match_offset_histogram[get_bit_width(offset)];
+        m_statistics->nbytes += length;
+
+        if (offset < minimum_vram_safe_offset)
+        {
+            ++m_statistics->nvram_unsafe_references;
+        }
+    }
+
+private:
+    lzss_decoder_statistics* m_statistics;
+};
+
+// LZSS decoder receiver which ignores the decoded data.
+// The decoder still checks the encoded data, so this can be used to validate it. References are not copied.
+class lzss_null_receiver final
+{
+public:
+    void tags(agbpack_u8) {}
+
+    void literal(agbpack_u8) {}
+
+    void reference(size_t, size_t) {}
+};
+
+// LZSS decoder receiver which does not produce any output but compares the decoded data against the data that was encoded.
+// References are verified by comparing against the data that was encoded too, so no sliding window is needed.
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+class lzss_verifying_receiver final
+{
+public:
+    explicit lzss_verifying_receiver(byte_verifier& verifier)
+        : m_verifier(&verifier)
+    {}
+
+    void tags(agbpack_u8) {}
+
+    void literal(agbpack_u8 literal)
+    {
+        m_verifier->verify8(literal);
+    }
+
+    void reference(size_t length, size_t offset)
+    {
+        while (length--)
+        {
+            m_verifier->verify8(m_verifier->verified_byte(offset));
+        }
+    }
+
+private:
+    byte_verifier* m_verifier;
+};
+
+// Decoder state at a point between two items of an LZSS stream.
+// * input_offset: offset of the next item (or tag byte) in the encoded stream, including the header
+// * tag_position: offset of the tag byte the next item belongs to, if it is not the first item of a tag group
+// * tag_mask: tag bit mask of the previous item. 0 if the next item starts a new tag group
+// * output_offset: number of bytes of uncompressed data preceding the next item
+// * window: uncompressed data preceding the next item, at most maximum_offset bytes.
+//   References of items following the checkpoint may not reach further back than that.
+export class lzss_checkpoint final
+{
+public:
+    explicit lzss_checkpoint(size_t input_offset, size_t tag_position, unsigned int tag_mask, size_t output_offset, vector<agbpack_u8> window)
+        : m_input_offset(input_offset)
+        , m_tag_position(tag_position)
+        , m_tag_mask(tag_mask)
+        , m_output_offset(output_offset)
+        , m_window(std::move(window))
+    {}
+
+    size_t input_offset() const { return m_input_offset; }
+
+    size_t tag_position() const { return m_tag_position; }
+
+    unsigned int tag_mask() const { return m_tag_mask; }
+
+    size_t output_offset() const { return m_output_offset; }
+
+    const vector<agbpack_u8>& window() const { return m_window; }
+
+private:
+    size_t m_input_offset;
+    size_t m_tag_position;
+    unsigned int m_tag_mask;
+    size_t m_output_offset;
+    vector<agbpack_u8> m_window;
+};
+
+export using lzss_index = checkpoint_index<lzss_checkpoint>;
+
 export class lzss_decoder final
 {
 public:
     template <std::input_iterator InputIterator, typename OutputIterator>
-    void decode(InputIterator input, InputIterator eof, OutputIterator output)
+    decode_result<InputIterator, OutputIterator> decode(InputIterator input, InputIterator eof, OutputIterator output)
     {
         static_assert_input_type<InputIterator>(); // TODO: probably we want to either remove this or extend it with the output iterator?
 
@@ -176,14 +399,149 @@ public:
         lzss_decoder_output_receiver<OutputIterator> receiver(output);
 
         decode_internal(reader, receiver);
+        return { reader.input(), receiver.output() };
     }
 
+    // Passes the decoded items to receiver. Like std::ranges::for_each, returns the receiver
+    // in its final state, together with the position following the end of the encoded stream.
     template <std::input_iterator InputIterator, lzss_receiver LzssReceiver>
-    void decode(InputIterator input, InputIterator eof, LzssReceiver receiver)
+    std::ranges::in_fun_result<InputIterator, LzssReceiver> decode(InputIterator input, InputIterator eof, LzssReceiver receiver)
     {
         static_assert_input_type<InputIterator>();
         byte_reader<InputIterator> reader(input, eof);
         decode_internal(reader, receiver);
+        return { reader.input(), std::move(receiver) };
+    }
+
+    // Checks whether the input is valid encoded data without producing any output. Throws decode_exception if it is not.
+    // Returns the position following the end of the encoded stream.
+    // This performs the same checks as decode, including the VRAM safety check if it is enabled,
+    // but since nothing is output references need not be copied, which makes it much faster than decode.
+    template <std::input_iterator InputIterator>
+    InputIterator validate(InputIterator input, InputIterator eof)
+    {
+        return decode(input, eof, lzss_null_receiver()).in;
+    }
+
+    // Decodes data encoded with a preset dictionary, see lzss_encoder. dictionary is the data preceding the
+    // uncompressed data, which references may refer to. It is not written to output.
+    template <std::input_iterator InputIterator, typename OutputIterator>
+    decode_result<InputIterator, OutputIterator> decode(InputIterator input, InputIterator eof, std::span<const agbpack_u8> dictionary, OutputIterator output)
+    {
+        static_assert_input_type<InputIterator>();
+
+        byte_reader<InputIterator> reader(input, eof);
+        auto header = parse_header(reader);
+
+        // References can only reach the last maximum_offset bytes of the dictionary
+        const auto window = dictionary.last(std::min(dictionary.size(), maximum_offset));
+        lzss_range_receiver<OutputIterator> receiver(header.uncompressed_size(), 0, 0, header.uncompressed_size(), output);
+        receiver.prime(window);
+
+        decoder_state state;
+        state.dictionary_size = window.size();
+        decode_items(reader, receiver, state, header.uncompressed_size(), header.uncompressed_size());
+        parse_padding_bytes(reader);
+        return { reader.input(), receiver.output() };
+    }
+
+    // Decodes length bytes of uncompressed data starting at offset.
+    // Decoding starts at the nearest checkpoint in front of offset. The index must have been
+    // created by an LZSS encoder when encoding the data. Note that only the data needed to
+    // decode the requested range is checked for errors.
+    template <std::random_access_iterator RandomAccessIterator, typename OutputIterator>
+    void decode_range(RandomAccessIterator input, RandomAccessIterator eof, const lzss_index& index, size_t offset, size_t length, OutputIterator output)
+    {
+        static_assert_input_type<RandomAccessIterator>();
+
+        byte_reader<RandomAccessIterator> header_reader(input, eof);
+        auto header = parse_header(header_reader);
+
+        if ((offset > header.uncompressed_size()) || (length > header.uncompressed_size() - offset))
+        {
+            throw std::out_of_range("range to decode is outside of uncompressed data");
+        }
+
+        decoder_state state;
+        auto position = input + header_size;
+        auto checkpoint = index.find(offset);
+        if (checkpoint)
+        {
+            state = resume_at(input, eof, *checkpoint, header.uncompressed_size());
+            position = input + make_signed(checkpoint->input_offset());
+        }
+
+        lzss_range_receiver<OutputIterator> receiver(header.uncompressed_size(), state.nbytes_written, offset, offset + length, output);
+        if (checkpoint)
+        {
+            receiver.prime(checkpoint->window());
+        }
+
+        byte_reader<RandomAccessIterator> reader(position, eof);
+        decode_items(reader, receiver, state, offset + length, header.uncompressed_size());
+    }
+
+    // Decodes the data on up to nthreads threads. 0 means one thread per hardware thread.
+    // The segments between two checkpoints of the index are decoded independently. The index must have
+    // been created by an LZSS encoder when encoding the data. With restart points enabled in the encoder
+    // the checkpoints at the restart points do not need to store any uncompressed data.
+    // Unlike decode, decode_parallel does not write the data sequentially, so output must allow random access.
+    template <std::random_access_iterator RandomAccessIterator, std::random_access_iterator OutputIterator>
+    void decode_parallel(RandomAccessIterator input, RandomAccessIterator eof, const lzss_index& index, OutputIterator output, unsigned int nthreads = 0)
+    {
+        static_assert_input_type<RandomAccessIterator>();
+
+        byte_reader<RandomAccessIterator> header_reader(input, eof);
+        auto header = parse_header(header_reader);
+
+        const auto& checkpoints = index.checkpoints();
+        if (!checkpoints.empty() && (checkpoints.back().output_offset() > header.uncompressed_size()))
+        {
+            throw std::invalid_argument("invalid LZSS checkpoint");
+        }
+
+        run_in_parallel(checkpoints.size() + 1, nthreads, [&](size_t segment)
+        {
+            const auto* checkpoint = segment ? &checkpoints[segment - 1] : nullptr;
+            const auto* next_checkpoint = segment < checkpoints.size() ? &checkpoints[segment] : nullptr;
+            const auto segment_end = next_checkpoint ? next_checkpoint->output_offset() : header.uncompressed_size();
+
+            decoder_state state;
+            size_t input_offset = header_size;
+            if (checkpoint)
+            {
+                state = resume_at(input, eof, *checkpoint, header.uncompressed_size());
+                input_offset = checkpoint->input_offset();
+            }
+
+            lzss_range_receiver<OutputIterator> receiver(header.uncompressed_size(), state.nbytes_written, state.nbytes_written, segment_end, output + make_signed(state.nbytes_written));
+            if (checkpoint)
+            {
+                receiver.prime(checkpoint->window());
+            }
+
+            byte_reader<RandomAccessIterator> reader(input + make_signed(input_offset), eof);
+            decode_items(reader, receiver, state, segment_end, header.uncompressed_size());
+            input_offset += reader.nbytes_read();
+
+            if (next_checkpoint)
+            {
+                if ((state.nbytes_written != next_checkpoint->output_offset()) ||
+                    (input_offset != next_checkpoint->input_offset()) ||
+                    (state.tag_mask != next_checkpoint->tag_mask()))
+                {
+                    throw decode_exception("index does not match encoded data");
+                }
+            }
+            else
+            {
+                // Padding is relative to the beginning of the stream, not to the beginning of the segment.
+                for (; (input_offset % 4) != 0; ++input_offset)
+                {
+                    read8(reader);
+                }
+            }
+        });
     }
 
     // When VRAM safety is enabled in the decoder, the decoder throws if the encoded data is not VRAM safe.
@@ -199,32 +557,56 @@ public:
     }
 
 private:
-    template <std::input_iterator InputIterator, typename LzssReceiver>
-    void decode_internal(byte_reader<InputIterator>& reader, LzssReceiver& receiver)
+    // Decoder state between two items. See lzss_checkpoint.
+    // history_begin is the output offset of the oldest byte references may refer to.
+    // dictionary_size is the number of bytes preceding the output which references may refer to.
+    struct decoder_state final
     {
-        static_assert_input_type<InputIterator>();
+        size_t nbytes_written = 0;
+        size_t history_begin = 0;
+        size_t dictionary_size = 0;
+        unsigned int tag_mask = 0;
+        agbpack_u8 tags = 0;
+    };
 
+    template <std::input_iterator InputIterator>
+    static header parse_header(byte_reader<InputIterator>& reader)
+    {
         auto header = header::parse_for_type(compression_type::lzss, read32(reader));
         if (!header)
         {
             throw decode_exception();
         }
 
-        unsigned int tag_mask = 0;
-        agbpack_u8 tags = 0;
-        size_t nbytes_written = 0;
+        return *header;
+    }
+
+    template <std::input_iterator InputIterator, typename LzssReceiver>
+    void decode_internal(byte_reader<InputIterator>& reader, LzssReceiver& receiver)
+    {
+        static_assert_input_type<InputIterator>();
+
+        auto header = parse_header(reader);
+        decoder_state state;
+        decode_items(reader, receiver, state, header.uncompressed_size(), header.uncompressed_size());
+        parse_padding_bytes(reader);
+    }
 
-        while (nbytes_written < header->uncompressed_size())
+    // Decodes items until at least end bytes of uncompressed data have been produced.
+    template <std::input_iterator InputIterator, typename LzssReceiver>
+    void decode_items(byte_reader<InputIterator>& reader, LzssReceiver& receiver, decoder_state& state, size_t end, size_t uncompressed_size)
+    {
+        while (state.nbytes_written < end)
         {
-            tag_mask >>= 1;
-            if (!tag_mask)
+            state.tag_mask >>= 1;
+            if (!state.tag_mask)
             {
-                tags = read8(reader);
-                tag_mask = 0x80;
-                receiver.tags(tags);
+                state.tags = read8(reader);
+                state.tag_mask = 0x80;
+                receiver.tags(state.tags);
             }
 
-            if (tags & tag_mask)
+            if (state.tags & state.tag_mask)
             {
                 auto b0 = read8(reader);
                 auto b1 = read8(reader);
@@ -234,25 +616,45 @@ private:
                 assert(in_closed_range(length, minimum_match_length, maximum_match_length) && "lzss_decoder is broken");
                 assert(in_closed_range(offset, minimum_offset, maximum_offset) && "lzss_decoder is broken");
 
-                throw_if_bad_reference(length, offset, nbytes_written, header->uncompressed_size());
+                throw_if_bad_reference(length, offset, state.dictionary_size + state.nbytes_written - state.history_begin, state.nbytes_written, uncompressed_size);
 
                 receiver.reference(length, offset);
-                nbytes_written += length;
+                state.nbytes_written += length;
             }
             else
             {
                 receiver.literal(read8(reader));
-                ++nbytes_written;
+                ++state.nbytes_written;
             }
         }
+    }
 
-        parse_padding_bytes(reader);
+    template <std::random_access_iterator RandomAccessIterator>
+    static decoder_state resume_at(RandomAccessIterator input, RandomAccessIterator eof, const lzss_checkpoint& checkpoint, size_t uncompressed_size)
+    {
+        const auto stream_size = static_cast<size_t>(eof - input);
+        if ((checkpoint.input_offset() < header_size) ||
+            (checkpoint.input_offset() > stream_size) ||
+            (checkpoint.output_offset() > uncompressed_size) ||
+            (checkpoint.window().size() > std::min(checkpoint.output_offset(), maximum_offset)) ||
+            (checkpoint.tag_mask() > 0x80) ||
+            (checkpoint.tag_mask() && (checkpoint.tag_position() >= checkpoint.input_offset())))
+        {
+            throw std::invalid_argument("invalid LZSS checkpoint");
+        }
+
+        decoder_state state;
+        state.nbytes_written = checkpoint.output_offset();
+        state.history_begin = checkpoint.output_offset() - checkpoint.window().size();
+        state.tag_mask = checkpoint.tag_mask();
+        state.tags = state.tag_mask ? input[make_signed(checkpoint.tag_position())] : 0;
+        return state;
     }
 
-    void throw_if_bad_reference(size_t length, size_t offset, size_t nbytes_written, size_t uncompressed_size)
+    void throw_if_bad_reference(size_t length, size_t offset, size_t history_size, size_t nbytes_written, size_t uncompressed_size)
     {
         throw_if_not_vram_safe(offset);
-        throw_if_outside_sliding_window(offset, nbytes_written);
+        throw_if_outside_sliding_window(offset, history_size);
         throw_if_reference_overflows_uncompressed_size(length, nbytes_written, uncompressed_size);
     }
 
@@ -264,9 +666,9 @@ private:
         }
     }
 
-    static void throw_if_outside_sliding_window(size_t offset, size_t nbytes_written)
+    static void throw_if_outside_sliding_window(size_t offset, size_t history_size)
     {
-        if (offset > nbytes_written)
+        if (offset > history_size)
         {
             throw decode_exception("reference outside of sliding window");
         }
@@ -283,6 +685,48 @@ private:
     bool m_vram_safe = false;
 };
 
+// Estimated number of CPU cycles the GBA BIOS needs to decode the parts of an LZSS stream.
+// The BIOS has one routine for decoding to WRAM, which writes bytes, and one for decoding
+// to VRAM, which collects bytes into halfwords. The estimates are rough: they assume the
+// encoded data is read from ROM with default wait states and ignore DMA and interrupts.
+// They are meant for comparing encodings of the same data, not for predicting exact timings.
+export struct lzss_decode_timing final
+{
+    size_t setup;           // Per stream: SWI overhead and header
+    size_t tag;             // Per tag byte
+    size_t literal;         // Per literal
+    size_t reference;       // Per reference, not including the bytes it copies
+    size_t reference_byte;  // Per byte copied by a reference
+};
+
+// Timings used by optimal_lzss_encoder's decode cycle weight. These are rough guesses, neither measured
+// nor counted from the BIOS code, so they are not exported until they have been calibrated on hardware.
+// The VRAM routine is assumed to be slower because it assembles halfwords before writing them.
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+inline constexpr lzss_decode_timing lzss_wram_decode_timing{ 60, 14, 18, 28, 10 };
+
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+inline constexpr lzss_decode_timing lzss_vram_decode_timing{ 60, 14, 24, 32, 14 };
+
+// Returns the estimated number of cycles needed to decode a stream, given its statistics.
+export inline size_t estimate_lzss_decode_cycles(const lzss_decoder_statistics& statistics, const lzss_decode_timing& timing)
+{
+    return timing.setup +
+        statistics.ntag_bytes * timing.tag +
+        statistics.nliterals * timing.literal +
+        statistics.nreferences * timing.reference +
+        (statistics.nbytes - statistics.nliterals) * timing.reference_byte;
+}
+
+// Returns the estimated number of cycles needed to decode an LZSS stream.
+export template <std::input_iterator InputIterator>
+size_t estimate_lzss_decode_cycles(InputIterator input, InputIterator eof, const lzss_decode_timing& timing)
+{
+    lzss_decoder_statistics statistics;
+    lzss_decoder().decode(input, eof, lzss_profiling_receiver(statistics));
+    return estimate_lzss_decode_cycles(statistics, timing);
+}
+
 AGBPACK_EXPORT_FOR_UNIT_TESTING
 class match final
 {
@@ -303,13 +747,61 @@ private:
     size_t m_offset;
 };
 
+// Returns the number of bytes at position which are equal to the bytes offset bytes in front of position.
+// The result is limited to maximum_length and to the end of input. offset must not be greater than position.
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+inline size_t common_prefix_length_scalar(std::span<const agbpack_u8> input, size_t position, size_t offset, size_t maximum_length)
+{
+    const auto limit = position < input.size() ? std::min(maximum_length, input.size() - position) : 0;
+    size_t length = 0;
+    while ((length < limit) && (input[position + length] == input[position + length - offset]))
+    {
+        ++length;
+    }
+
+    return length;
+}
+
+// Same as common_prefix_length_scalar, but compares 16 bytes at a time where SSE2 is available.
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+inline size_t common_prefix_length(std::span<const agbpack_u8> input, size_t position, size_t offset, size_t maximum_length)
+{
+#ifdef AGBPACK_HAVE_SSE2
+    const auto limit = position < input.size() ? std::min(maximum_length, input.size() - position) : 0;
+    size_t length = 0;
+    for (; length + 16 <= limit; length += 16)
+    {
+        // Load using memcpy rather than casting to __m128i*, which would increase alignment requirements
+        const auto* current = input.data() + position + length;
+        __m128i a;
+        __m128i b;
+        std::memcpy(&a, current, sizeof(a));
+        std::memcpy(&b, current - offset, sizeof(b));
+        const auto equal = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)));
+        if (equal != 0xffff)
+        {
+            return length + static_cast<size_t>(std::countr_one(equal));
+        }
+    }
+
+    while ((length < limit) && (input[position + length] == input[position + length - offset]))
+    {
+        ++length;
+    }
+
+    return length;
+#else
+    return common_prefix_length_scalar(input, position, offset, maximum_length);
+#endif
+}
+
 // Simple implementation using two nested loops each doing linear search.
 AGBPACK_EXPORT_FOR_UNIT_TESTING
 class greedy_match_finder final
 {
 public:
     // Note: greedy_match_finder does not own input
-    explicit greedy_match_finder(const vector<agbpack_u8>& input, size_t minimum_match_offset)
+    explicit greedy_match_finder(std::span<const agbpack_u8> input, size_t minimum_match_offset)
         : m_input(input)
         , m_minimum_match_offset(minimum_match_offset)
     {}
@@ -323,25 +815,8 @@ public:
         size_t offset = std::min(current_position, maximum_offset);
         for (; offset > m_minimum_match_offset; --offset)
         {
-            // Inner loop: check for match at current position, increasing match length each iteration.
-            // Note: close to the end of input, iterating over the entire range [0, maximum_match_length]
-            // is pointless if that exceeds the available input. This could easily be optimized, but
-            // considering we're doing linear search that would be a micro optimization.
-            size_t length = 0;
-            for (; length < maximum_match_length; ++length)
-            {
-                if (current_position + length >= m_input.size())
-                {
-                    // End of lookahead reached, abort search
-                    break;
-                }
-
-                if (m_input[current_position + length] != m_input[current_position + length - offset])
-                {
-                    // Characters differ, abort search
-                    break;
-                }
-            }
+            // Inner search: length of match at current position, limited by the end of lookahead.
+            const auto length = common_prefix_length(m_input, current_position, offset, maximum_match_length);
 
             if (length > best_match.length())
             {
@@ -358,80 +833,677 @@ public:
     }
 
 private:
-    const vector<agbpack_u8>& m_input;
+    std::span<const agbpack_u8> m_input;
     size_t m_minimum_match_offset;
 };
 
-AGBPACK_EXPORT_FOR_UNIT_TESTING
-class lzss_bitstream_writer final
+// Walks the greedy parse of the match finder's input from begin to end, calling f(position, match) for each item.
+// A match shorter than minimum_match_length stands for a literal. Data in front of begin is only referenced.
+// The match at a position does not depend on the parse leading to it. This allows the parse to be
+// computed in parallel: the input is split into chunks, and each chunk is parsed speculatively from
+// its beginning. The sequential walk then reuses the speculative matches. Where the walk enters a chunk
+// at a position which is not part of the chunk's speculative parse, it finds matches itself until it
+// reaches a position which is. Usually this happens after a few items. The result is the same as
+// parsing sequentially. While parsing speculatively, progress_offset plus the number of bytes parsed
+// so far is reported as progress. After that, progress is reported by f.
+template <typename F>
+void parse_greedy(const greedy_match_finder& match_finder, size_t begin, size_t end, unsigned int nthreads, progress_reporter& reporter, size_t progress_offset, F f)
 {
-public:
-    // Note: lzss_bitstream_writer does not own encoded_data
-    explicit lzss_bitstream_writer(vector<agbpack_u8>& encoded_data)
-        : m_encoded_data(encoded_data)
-    {}
-
-    void write_literal(agbpack_u8 literal)
+    struct parsed_item final
     {
-        write_tag(false);
-        m_encoded_data.push_back(literal);
-    }
+        size_t position;
+        match found_match;
+    };
+
+    constexpr size_t minimum_chunk_size = 16 * 1024;
+    constexpr size_t chunks_per_thread = 4;
+    const auto size = end - begin;
+    // Only parse speculatively when there are threads to do so in parallel. A single thread would
+    // merely do the work of the sequential parse below up front, and hold all of its results in memory.
+    const auto nworkers = get_nthreads(nthreads);
+    const auto nchunks = nworkers > 1 ? std::min<size_t>(nworkers * chunks_per_thread, size / minimum_chunk_size) : 0;
+    const auto chunk_size = nchunks > 1 ? (size + nchunks - 1) / nchunks : size;
+
+    auto next_position = [](size_t position, const match& match)
+    {
+        return position + (match.length() >= minimum_match_length ? match.length() : 1);
+    };
 
-    void write_reference(size_t length, size_t offset)
+    vector<vector<parsed_item>> chunks(nchunks > 1 ? nchunks : 0);
+    std::atomic<size_t> nbytes_parsed = 0;
+    const auto calling_thread = std::this_thread::get_id();
+    run_in_parallel(chunks.size(), nthreads, [&](size_t chunk)
     {
-        assert(in_closed_range(length, minimum_match_length, maximum_match_length));
-        assert(in_closed_range(offset, minimum_offset, maximum_offset));
+        const auto chunk_begin = begin + chunk * chunk_size;
+        const auto chunk_end = begin + std::min(size, (chunk + 1) * chunk_size);
+        auto counted_position = chunk_begin;
 
-        write_tag(true);
+        auto count_parsed_bytes = [&](size_t position)
+        {
+            nbytes_parsed += position - counted_position;
+            counted_position = position;
 
-        auto b0 = ((length - minimum_match_length) << 4) | ((offset - minimum_offset) >> 8);
+            // The progress reporter must only be used on the calling thread
+            if (std::this_thread::get_id() == calling_thread)
+            {
+                reporter.update(progress_offset + nbytes_parsed);
+            }
+        };
+
+        for (auto position = chunk_begin; position < chunk_end;)
+        {
+            reporter.throw_if_cancelled();
+            const auto match = match_finder.find_match(position);
+            chunks[chunk].push_back({ position, match });
+            position = next_position(position, match);
+
+            if ((position < chunk_end) && (position - counted_position >= progress_reporter::interval))
+            {
+                count_parsed_bytes(position);
+            }
+        }
+
+        count_parsed_bytes(chunk_end);
+    });
+
+    size_t chunk = 0;
+    size_t item = 0;
+    for (size_t position = begin; position < end;)
+    {
+        if (chunk < chunks.size() && position >= begin + (chunk + 1) * chunk_size)
+        {
+            ++chunk;
+            item = 0;
+        }
+
+        const auto* parsed_items = chunk < chunks.size() ? &chunks[chunk] : nullptr;
+        while (parsed_items && (item < parsed_items->size()) && ((*parsed_items)[item].position < position))
+        {
+            ++item;
+        }
+
+        const auto match = (parsed_items && (item < parsed_items->size()) && ((*parsed_items)[item].position == position))
+            ? (*parsed_items)[item].found_match
+            : match_finder.find_match(position);
+
+        f(position, match);
+        position = next_position(position, match);
+    }
+}
+
+// Finds matches using hash chains: each position is inserted into the chain of positions whose
+// next minimum_match_length bytes have the same hash. A search follows the chain of the current
+// position from the most recent position backwards, so it only compares positions which are likely
+// to match. The effort is limited by the maximum number of chain links followed per search and by
+// the nice match length: once a match at least that long has been found the search stops.
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+class hash_chain_match_finder final
+{
+public:
+    // Note: hash_chain_match_finder does not own input
+    explicit hash_chain_match_finder(std::span<const agbpack_u8> input, size_t minimum_match_offset, size_t maximum_chain_length, size_t nice_match_length)
+        : m_input(input)
+        , m_minimum_match_offset(minimum_match_offset)
+        , m_maximum_chain_length(maximum_chain_length)
+        , m_nice_match_length(nice_match_length)
+        , m_head(hash_size, no_position)
+        , m_previous(input.size(), no_position)
+    {}
+
+    // Finds a match at current_position. All positions in front of current_position must have been inserted.
+    match find_match(size_t current_position) const
+    {
+        match best_match(0, 0);
+        if (current_position + minimum_match_length > m_input.size())
+        {
+            return best_match;
+        }
+
+        auto candidate = m_head[hash(current_position)];
+        for (size_t nlinks = 0; (candidate != no_position) && (nlinks < m_maximum_chain_length); ++nlinks, candidate = m_previous[candidate])
+        {
+            const auto offset = current_position - candidate;
+            if (offset > maximum_offset)
+            {
+                // Chains are ordered by position, so all remaining candidates are out of reach too
+                break;
+            }
+
+            if (offset > m_minimum_match_offset)
+            {
+                const auto length = common_prefix_length(m_input, current_position, offset, maximum_match_length);
+                if (length > best_match.length())
+                {
+                    best_match = match(length, offset);
+                    if (length >= m_nice_match_length)
+                    {
+                        break;
+                    }
+                }
+            }
+        }
+
+        return best_match;
+    }
+
+    // Inserts a position into its hash chain. Positions must be inserted in ascending order.
+    void insert(size_t position)
+    {
+        if (position + minimum_match_length <= m_input.size())
+        {
+            const auto h = hash(position);
+            m_previous[position] = m_head[h];
+            m_head[h] = static_cast<agbpack_u32>(position);
+        }
+    }
+
+private:
+    static constexpr size_t hash_bits = 15;
+    static constexpr size_t hash_size = size_t(1) << hash_bits;
+    static constexpr agbpack_u32 no_position = 0xffffffff;
+
+    // Multiplicative hash of the next three bytes
+    size_t hash(size_t position) const
+    {
+        const agbpack_u32 value = (agbpack_u32{ m_input[position] } << 16) | (agbpack_u32{ m_input[position + 1] } << 8) | m_input[position + 2];
+        return (value * agbpack_u32{ 2654435761u }) >> (32 - hash_bits);
+    }
+
+    std::span<const agbpack_u8> m_input;
+    size_t m_minimum_match_offset;
+    size_t m_maximum_chain_length;
+    size_t m_nice_match_length;
+    vector<agbpack_u32> m_head;
+    vector<agbpack_u32> m_previous;
+};
+
+// Match search effort of an lzss_encoder compression level.
+// Lazy matching is tried for matches shorter than maximum_lazy_match_length, so 0 disables it.
+struct lzss_search_parameters final
+{
+    size_t maximum_chain_length;
+    size_t nice_match_length;
+    size_t maximum_lazy_match_length;
+};
+
+// Walks a parse of input from begin to its end found using a hash_chain_match_finder, calling f(position, match) for each item.
+// Like parse_greedy, a match shorter than minimum_match_length stands for a literal, and data in front of begin is only referenced.
+// With lazy matching, a literal is emitted instead of a match if there is a sufficiently longer match at the next position.
+// stop(position) is called before each item. If it returns true, the parse ends early at position.
+template <typename F, typename Stop>
+void parse_hash_chains(std::span<const agbpack_u8> input, size_t begin, size_t minimum_match_offset, const lzss_search_parameters& parameters, F f, Stop stop)
+{
+    hash_chain_match_finder match_finder(input, minimum_match_offset, parameters.maximum_chain_length, parameters.nice_match_length);
+    size_t ninserted = 0;
+    auto find_match = [&](size_t position)
+    {
+        for (; ninserted < position; ++ninserted)
+        {
+            match_finder.insert(ninserted);
+        }
+
+        return match_finder.find_match(position);
+    };
+
+    auto current_match = find_match(begin);
+    for (size_t position = begin; (position < input.size()) && !stop(position);)
+    {
+        if ((current_match.length() >= minimum_match_length) && (current_match.length() < parameters.maximum_lazy_match_length))
+        {
+            // A literal costs about half as much as a reference, so deferring only pays off
+            // if the match at the next position is at least two bytes longer.
+            const auto next_match = find_match(position + 1);
+            if (next_match.length() > current_match.length() + 1)
+            {
+                f(position, match(1, 0));
+                ++position;
+                current_match = next_match;
+                continue;
+            }
+        }
+
+        f(position, current_match);
+        position += current_match.length() >= minimum_match_length ? current_match.length() : 1;
+        current_match = find_match(position);
+    }
+}
+
+template <typename F>
+void parse_hash_chains(std::span<const agbpack_u8> input, size_t begin, size_t minimum_match_offset, const lzss_search_parameters& parameters, F f)
+{
+    parse_hash_chains(input, begin, minimum_match_offset, parameters, f, [](size_t) { return false; });
+}
+
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+class lzss_bitstream_writer final
+{
+public:
+    // Note: lzss_bitstream_writer does not own encoded_data
+    explicit lzss_bitstream_writer(vector<agbpack_u8>& encoded_data)
+        : m_encoded_data(encoded_data)
+    {}
+
+    // Catches a missing flush() in debug builds. An exception, e.g. a cancelled encode, may abandon an incomplete group.
+    ~lzss_bitstream_writer()
+    {
+        assert(((m_group_size == 0) || (std::uncaught_exceptions() > m_uncaught_exceptions)) && "lzss_bitstream_writer was not flushed");
+    }
+
+    lzss_bitstream_writer(const lzss_bitstream_writer&) = delete;
+    lzss_bitstream_writer& operator=(const lzss_bitstream_writer&) = delete;
+
+    // Upper bound for the size of the bitstream: all items are literals.
+    static size_t maximum_encoded_size(size_t uncompressed_size)
+    {
+        return uncompressed_size + (uncompressed_size + 7) / 8;
+    }
+
+    void write_literal(agbpack_u8 literal)
+    {
+        start_item();
+        m_group[m_group_size++] = literal;
+        end_item();
+    }
+
+    void write_reference(size_t length, size_t offset)
+    {
+        assert(in_closed_range(length, minimum_match_length, maximum_match_length));
+        assert(in_closed_range(offset, minimum_offset, maximum_offset));
+
+        start_item();
+
+        auto b0 = ((length - minimum_match_length) << 4) | ((offset - minimum_offset) >> 8);
         auto b1 = (offset - minimum_offset) & 255;
 
-        m_encoded_data.push_back(static_cast<agbpack_u8>(b0));
-        m_encoded_data.push_back(static_cast<agbpack_u8>(b1));
+        m_group[0] |= m_tag_bitmask;
+        m_group[m_group_size++] = static_cast<agbpack_u8>(b0);
+        m_group[m_group_size++] = static_cast<agbpack_u8>(b1);
+        end_item();
+    }
+
+    // Appends an incomplete group of items to the encoded data.
+    // Must be called after the last item has been written.
+    void flush()
+    {
+        m_encoded_data.insert(m_encoded_data.end(), m_group.begin(), m_group.begin() + make_signed(m_group_size));
+        m_group_size = 0;
     }
 
+    size_t nbytes_written() const { return m_encoded_data.size() + m_group_size; }
+
+    agbpack_u8 tag_bitmask() const { return m_tag_bitmask; }
+
+    size_t tag_byte_position() const { return m_tag_byte_position; }
+
 private:
-    void write_tag(bool is_reference)
+    void start_item()
     {
         m_tag_bitmask >>= 1;
         if (!m_tag_bitmask)
         {
-            // Tag byte is full.
-            // Allocate space for a new one in the output and remember its position.
+            // Start a new group. Its tag byte goes in front of its items.
             m_tag_bitmask = 0x80;
-            m_encoded_data.push_back(0);
-            m_tag_byte_position = m_encoded_data.size() - 1;
+            m_tag_byte_position = m_encoded_data.size();
+            m_group[0] = 0;
+            m_group_size = 1;
         }
+    }
 
-        if (is_reference)
+    void end_item()
+    {
+        // A group is complete after 8 items. Its size is known now, so it can be appended to the encoded data.
+        if (m_tag_bitmask == 1)
         {
-            m_encoded_data[m_tag_byte_position] |= m_tag_bitmask;
+            flush();
         }
     }
 
+    // A group consists of a tag byte plus up to 8 items, each of which is at most 2 bytes.
+    std::array<agbpack_u8, 17> m_group{};
+    size_t m_group_size = 0;
     agbpack_u8 m_tag_bitmask = 0;
     size_t m_tag_byte_position = 0;
     vector<agbpack_u8>& m_encoded_data;
+    int m_uncaught_exceptions = std::uncaught_exceptions();
 };
 
+// Statistics collected by lzss_encoder and optimal_lzss_encoder.
+export struct lzss_encoder_statistics final
+{
+    size_t nliterals = 0;
+    size_t nreferences = 0;
+
+    // Number of references by length. The index is the match length.
+    std::array<size_t, maximum_match_length + 1> match_length_histogram{};
+
+    // Number of references by offset. The index is the bit width of the offset:
+    // 1 for offset 1, 2 for offsets 2-3, 3 for offsets 4-7 and so on, up to 13 for offset 4096.
+    std::array<size_t, get_bit_width(maximum_offset) + 1> match_offset_histogram{};
+
+    // Number of bytes of encoded data taken up by tag bytes.
+    size_t ntag_bytes = 0;
+
+    std::vector<encoder_phase_time> phase_times;
+};
+
+template <typename Statistics>
+void record_literal([[maybe_unused]] Statistics& statistics)
+{
+    if constexpr (collects_statistics<Statistics>)
+    {
+        ++statistics.nliterals;
+    }
+}
+
+template <typename Statistics>
+void record_reference([[maybe_unused]] Statistics& statistics, [[maybe_unused]] size_t length, [[maybe_unused]] size_t offset)
+{
+    if constexpr (collects_statistics<Statistics>)
+    {
+        ++statistics.nreferences;
+        ++statistics.match_length_histogram[length];
+        ++statistics.match_offset_histogram[get_bit_width(offset)];
+    }
+}
+
+template <typename Statistics>
+void record_tag_bytes([[maybe_unused]] Statistics& statistics)
+{
+    if constexpr (collects_statistics<Statistics>)
+    {
+        // Each tag byte holds the tags of up to 8 items
+        statistics.ntag_bytes = (statistics.nliterals + statistics.nreferences + 7) / 8;
+    }
+}
+
+// Calls f(block, block_offset) for each block of input.
+// With restart points enabled, input is split into blocks of restart_interval bytes. Otherwise there is only one block.
+template <typename F>
+void for_each_block(std::span<const agbpack_u8> input, size_t restart_interval, F f)
+{
+    const size_t block_size = restart_interval ? restart_interval : input.size();
+    for (size_t block_offset = 0; block_offset < input.size(); block_offset += block_size)
+    {
+        f(input.subspan(block_offset, std::min(block_size, input.size() - block_offset)), block_offset);
+    }
+}
+
+// Records checkpoints into an lzss_index while an LZSS encoder writes its bitstream.
+// Offsets in the encoded stream are recorded relative to the beginning of the stream, including the header.
+// At restart points a checkpoint with an empty window is recorded, since no reference reaches past a restart point.
+class lzss_checkpoint_recorder final
+{
+public:
+    // Note: lzss_checkpoint_recorder owns neither index nor input. index may be nullptr.
+    explicit lzss_checkpoint_recorder(lzss_index* index, const vector<agbpack_u8>& input, size_t restart_interval)
+        : m_index(index)
+        , m_input(input)
+        , m_restart_interval(restart_interval)
+    {
+        if (m_index)
+        {
+            m_index->clear();
+        }
+    }
+
+    // Call this after each item written with the number of bytes of input encoded so far.
+    void item_written(size_t output_offset, const lzss_bitstream_writer& writer)
+    {
+        if (!m_index || (output_offset >= m_input.size()))
+        {
+            return;
+        }
+
+        const auto block_offset = m_restart_interval ? output_offset - output_offset % m_restart_interval : 0;
+        if ((block_offset == output_offset) || m_index->checkpoint_due(output_offset))
+        {
+            const auto window_begin = m_input.begin() + make_signed(std::max(block_offset, output_offset - std::min(output_offset, maximum_offset)));
+            const auto window_end = m_input.begin() + make_signed(output_offset);
+
+            m_index->add(lzss_checkpoint(
+                header_size + writer.nbytes_written(),
+                header_size + writer.tag_byte_position(),
+                writer.tag_bitmask(),
+                output_offset,
+                vector<agbpack_u8>(window_begin, window_end)));
+        }
+    }
+
+private:
+    lzss_index* m_index;
+    const vector<agbpack_u8>& m_input;
+    size_t m_restart_interval;
+};
+
+using match_cost_callback = size_t (*)(size_t distance, size_t length, void* user);
+
+inline size_t get_match_cost(const size_t, const size_t length, void* const)
+{
+    if (length < minimum_match_length)
+    {
+        return 0;
+    }
+
+    return match_cost;
+}
+
+inline size_t get_match_cost_vram_safe(const size_t distance, const size_t length, void* const)
+{
+    if ((length < minimum_match_length) || (distance < minimum_vram_safe_offset))
+    {
+        return 0;
+    }
+
+    return match_cost;
+}
+
+// User data clownlzss passes to its callbacks.
+struct clownlzss_user_data final
+{
+    const void* cost_model;
+    progress_reporter* reporter;
+    size_t offset;
+    size_t history_size;
+    std::chrono::steady_clock::time_point deadline;
+    bool deadline_passed;
+    std::exception_ptr exception;
+};
+
+// Called by clownlzss every few thousand values. Exceptions must not propagate through C code,
+// so they are stored and clownlzss is told to give up. clownlzss is also told to give up when the deadline has passed.
+inline int report_clownlzss_progress(const size_t values_done, const size_t, void* const user)
+{
+    auto& user_data = *static_cast<clownlzss_user_data*>(user);
+    try
+    {
+        if (std::chrono::steady_clock::now() >= user_data.deadline)
+        {
+            user_data.deadline_passed = true;
+            return 0;
+        }
+
+        const auto nbytes_done = values_done * bytes_per_value;
+        user_data.reporter->update(user_data.offset + nbytes_done - std::min(nbytes_done, user_data.history_size));
+        user_data.reporter->throw_if_cancelled();
+        return 1;
+    }
+    catch (...)
+    {
+        user_data.exception = std::current_exception();
+        return 0;
+    }
+}
+
+// Called by clownlzss at each position before it adds the edges leaving it to the graph.
+// At the end of the history, all paths through edges leaving the history are discarded,
+// so that the shortest path passes through the end of the history.
+inline void cut_clownlzss_graph_at_history_end(const unsigned char*, const size_t total_values, const size_t offset, ClownLZSS_GraphEdge* const node_meta_array, void* const user)
+{
+    const auto& user_data = *static_cast<const clownlzss_user_data*>(user);
+    if (offset * bytes_per_value == user_data.history_size)
+    {
+        for (auto node = offset + 1; node <= std::min(offset + maximum_match_length, total_values); ++node)
+        {
+            node_meta_array[node].u.cost = std::numeric_limits<size_t>::max();
+        }
+    }
+}
+
+// Called by clownlzss to find the length of the run of equal bytes at current and match, where match < current.
+inline size_t compare_clownlzss_bytes(const unsigned char* const current, const unsigned char* const match, const size_t maximum_length)
+{
+    const auto offset = static_cast<size_t>(current - match);
+    return common_prefix_length(std::span<const agbpack_u8>(match, offset + maximum_length), offset, offset, maximum_length);
+}
+
+// Finds an optimal parse of data using clownlzss. The match cost callback receives a pointer
+// to a clownlzss_user_data holding cost_model. Progress is reported relative to offset.
+// The first history_size bytes of data are parsed too, but no match crosses the end of the history,
+// so the matches from there on are an optimal parse of the remaining data which may refer to the history.
+// If the deadline passes before the parse is complete, the search is given up and the returned matches are null.
+inline std::pair<ClownLZSS::Matches, size_t> find_optimal_lzss_matches(
+    std::span<const agbpack_u8> data,
+    size_t literal_cost_value,
+    match_cost_callback get_match_cost_value,
+    const void* cost_model,
+    progress_reporter& reporter,
+    size_t offset,
+    size_t history_size = 0,
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max())
+{
+    ClownLZSS::Matches matches;
+    size_t total_matches;
+    clownlzss_user_data user_data{ cost_model, &reporter, offset, history_size, deadline, false, nullptr };
+
+    if (!ClownLZSS::FindOptimalMatches(
+        filler_value,
+        maximum_match_length,
+        maximum_match_distance,
+        history_size ? cut_clownlzss_graph_at_history_end : nullptr,
+        literal_cost_value,
+        get_match_cost_value,
+        report_clownlzss_progress,
+        compare_clownlzss_bytes,
+        data.data(),
+        bytes_per_value,
+        data.size() / bytes_per_value,
+        &matches,
+        &total_matches,
+        &user_data))
+    {
+        if (user_data.exception)
+        {
+            std::rethrow_exception(user_data.exception);
+        }
+
+        if (user_data.deadline_passed)
+        {
+            return std::make_pair(ClownLZSS::Matches(), size_t{ 0 });
+        }
+
+        throw encode_exception("optimal LZSS encoding failed. That should not happen, unless the system is extremely low on memory");
+    }
+
+    return std::make_pair(std::move(matches), total_matches);
+}
+
+// Writes an LZSS stream to output: header, encoded data and padding.
+template <typename OutputIterator>
+void write_lzss_stream(size_t uncompressed_size, const vector<agbpack_u8>& encoded_data, OutputIterator output)
+{
+    const auto header = header::create(lzss_options::reserved, uncompressed_size);
+    unbounded_byte_writer<OutputIterator> writer(output);
+    write32(writer, header.to_uint32_t());
+    write(writer, encoded_data.begin(), encoded_data.end());
+    write_padding_bytes(writer);
+}
+
+// Verifies encoded data by decoding it, see verify_encoded_data.
+// The decoder also checks the references against the dictionary, if there is one, and for VRAM safety, if requested.
+// The decoder reads the stream write_lzss_stream would write through a view, so the encoded data is not copied.
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+inline void verify_lzss_stream(std::span<const agbpack_u8> uncompressed_data, const vector<agbpack_u8>& encoded_data, std::span<const agbpack_u8> dictionary, bool vram_safe)
+{
+    std::array<agbpack_u8, header_size> header_bytes;
+    unbounded_byte_writer<agbpack_u8*> header_writer(header_bytes.data());
+    write32(header_writer, header::create(lzss_options::reserved, uncompressed_data.size()).to_uint32_t());
+
+    constexpr std::array<agbpack_u8, 3> padding_bytes{};
+    const auto npadding_bytes = (4 - (header_size + encoded_data.size()) % 4) % 4;
+
+    const std::array<std::span<const agbpack_u8>, 3> parts{ header_bytes, encoded_data, std::span(padding_bytes).first(npadding_bytes) };
+    const auto stream = parts | std::views::join;
+
+    verify_encoded_data(uncompressed_data, [&](byte_verifier& verifier)
+    {
+        lzss_decoder decoder;
+        decoder.vram_safe(vram_safe);
+        if (dictionary.empty())
+        {
+            decoder.decode(stream.begin(), stream.end(), lzss_verifying_receiver(verifier));
+        }
+        else
+        {
+            decoder.decode(stream.begin(), stream.end(), dictionary, verifying_output_iterator(verifier));
+        }
+    });
+}
+
 export class lzss_encoder final
 {
 public:
+    static constexpr int default_level = 0;
+    static constexpr int minimum_level = 0;
+    static constexpr int maximum_level = 9;
+
     template <std::input_iterator InputIterator, typename OutputIterator>
     void encode(InputIterator input, InputIterator eof, OutputIterator output)
+    {
+        encode(input, eof, output, nullptr);
+    }
+
+    // Encodes data and records decoder checkpoints into index.
+    // The encoded data is the same as without an index.
+    template <std::input_iterator InputIterator, typename OutputIterator>
+    void encode(InputIterator input, InputIterator eof, OutputIterator output, lzss_index& index)
+    {
+        encode(input, eof, output, &index);
+    }
+
+    // Encodes data and collects statistics about the encoded data.
+    // The encoded data is the same as without statistics.
+    template <std::input_iterator InputIterator, typename OutputIterator>
+    void encode(InputIterator input, InputIterator eof, OutputIterator output, lzss_encoder_statistics& statistics)
+    {
+        statistics = {};
+        encode(input, eof, output, nullptr, statistics);
+    }
+
+    // Encodes data using a preset dictionary, typically data similar to the input such as the previous version of an asset.
+    // References may refer to the dictionary as if it immediately preceded the input. Only the last maximum_offset bytes
+    // of the dictionary are within reach, so any bytes in front of them are ignored. The encoded data must be decoded
+    // with the same dictionary, see lzss_decoder. The GBA BIOS can decode it too, if the dictionary is stored immediately
+    // in front of the destination. A dictionary cannot be used together with restart points.
+    template <std::input_iterator InputIterator, typename OutputIterator>
+    void encode(InputIterator input, InputIterator eof, std::span<const agbpack_u8> dictionary, OutputIterator output)
     {
         static_assert_input_type<InputIterator>();
 
+        if (m_restart_interval && !dictionary.empty())
+        {
+            throw std::invalid_argument("restart points cannot be used together with a dictionary");
+        }
+
+        no_statistics statistics;
         const auto uncompressed_data = vector<agbpack_u8>(input, eof);
-        const auto encoded_data = encode_internal(uncompressed_data);
-        const auto header = header::create(lzss_options::reserved, uncompressed_data.size());
+        const auto window = dictionary.last(std::min(dictionary.size(), maximum_offset));
+        const auto encoded_data = encode_internal(uncompressed_data, window, nullptr, statistics);
+        if (m_verify)
+        {
+            verify_lzss_stream(uncompressed_data, encoded_data, window, m_vram_safe);
+        }
 
-        // Copy header and encoded data to output
-        unbounded_byte_writer<OutputIterator> writer(output);
-        write32(writer, header.to_uint32_t());
-        write(writer, encoded_data.begin(), encoded_data.end());
-        write_padding_bytes(writer);
+        write_lzss_stream(uncompressed_data.size(), encoded_data, output);
     }
 
     void vram_safe(bool enable)
@@ -444,35 +1516,220 @@ public:
         return m_vram_safe;
     }
 
+    // When restart points are enabled, the data is encoded in independent blocks of restart_interval bytes:
+    // no reference refers to data in front of the block it belongs to. The encoded data is still a single
+    // valid LZSS stream, but it is slightly bigger. If an index is created while encoding, a checkpoint
+    // is recorded at the beginning of each block, which allows the blocks to be decoded in parallel.
+    // 0 disables restart points.
+    void restart_interval(size_t interval)
+    {
+        m_restart_interval = interval;
+    }
+
+    size_t restart_interval() const
+    {
+        return m_restart_interval;
+    }
+
+    // Number of threads to use. 0 means one thread per hardware thread.
+    // With more than one thread, matches in big inputs are searched on separate threads.
+    // This is only done at level 0. The encoded data is the same as with a single thread.
+    void nthreads(unsigned int nthreads)
+    {
+        m_nthreads = nthreads;
+    }
+
+    unsigned int nthreads() const
+    {
+        return m_nthreads;
+    }
+
+    // Compression level, trading encoding speed for size of the encoded data.
+    // * Levels 1 to 8 search matches using hash chains. Higher levels compare more positions,
+    //   and from level 4 on lazy matching is used.
+    // * Level 9 finds an optimal parse, like optimal_lzss_encoder without decode cycle weight.
+    // * Level 0 is not part of this scale. It searches the entire sliding window for the longest match
+    //   at each position, which is slower than level 8 and usually yields bigger output. It is the default
+    //   nevertheless, because it is how earlier versions of agbpack encoded data, so upgrading does not
+    //   change the encoded data of existing assets. It is also the only level that can use multiple threads.
+    void level(int level)
+    {
+        if ((level < minimum_level) || (level > maximum_level))
+        {
+            throw std::invalid_argument("invalid lzss compression level");
+        }
+
+        m_level = level;
+    }
+
+    int level() const
+    {
+        return m_level;
+    }
+
+    // Reports progress to progress and allows encoding to be cancelled through it. nullptr disables this.
+    void progress(std::shared_ptr<encode_progress> progress)
+    {
+        m_progress = std::move(progress);
+    }
+
+    const std::shared_ptr<encode_progress>& progress() const
+    {
+        return m_progress;
+    }
+
+    // When verification is enabled, the encoded data is decoded and compared against the input before it is written to output.
+    // If they differ, encode throws encode_exception. The decoder also checks VRAM safety if VRAM safe encoding is enabled.
+    // Verification does not need a buffer for the decoded data. It takes about as long as decoding, which is little compared to
+    // encoding at levels 0 and 9, but noticeable at the fastest levels. See lzss_encoder_verify_benchmark in the tests.
+    void verify(bool enable)
+    {
+        m_verify = enable;
+    }
+
+    bool verify() const
+    {
+        return m_verify;
+    }
+
 private:
-    vector<agbpack_u8> encode_internal(const vector<agbpack_u8>& input)
+    template <std::input_iterator InputIterator, typename OutputIterator>
+    void encode(InputIterator input, InputIterator eof, OutputIterator output, lzss_index* index)
+    {
+        no_statistics statistics;
+        encode(input, eof, output, index, statistics);
+    }
+
+    template <std::input_iterator InputIterator, typename OutputIterator, typename Statistics>
+    void encode(InputIterator input, InputIterator eof, OutputIterator output, lzss_index* index, Statistics& statistics)
+    {
+        static_assert_input_type<InputIterator>();
+
+        const auto uncompressed_data = vector<agbpack_u8>(input, eof);
+        const auto encoded_data = encode_internal(uncompressed_data, {}, index, statistics);
+        if (m_verify)
+        {
+            measure_phase(statistics, "verify", [&]() { verify_lzss_stream(uncompressed_data, encoded_data, {}, m_vram_safe); });
+        }
+
+        write_lzss_stream(uncompressed_data.size(), encoded_data, output);
+    }
+
+    // dictionary must not be longer than maximum_offset. If it is not empty, restart points must be disabled.
+    template <typename Statistics>
+    vector<agbpack_u8> encode_internal(const vector<agbpack_u8>& input, std::span<const agbpack_u8> dictionary, lzss_index* index, Statistics& statistics)
     {
+        assert((dictionary.size() <= maximum_offset) && (dictionary.empty() || !m_restart_interval) && "lzss_encoder is broken");
+
         vector<agbpack_u8> encoded_data;
-        greedy_match_finder match_finder(input, get_minimum_offset(m_vram_safe) - 1); // TODO: unhardcode. What's somewhat ugly: greedy_match_finder uses zero based offfset, whereas global constant uses one based offset
+        encoded_data.reserve(lzss_bitstream_writer::maximum_encoded_size(input.size()));
         lzss_bitstream_writer writer(encoded_data);
+        lzss_checkpoint_recorder recorder(index, input, m_restart_interval);
+        progress_reporter reporter(m_progress.get(), input.size());
 
-        size_t current_position = 0;
-        while (current_position < input.size())
+        // Encodes a block. data consists of history_size bytes of history, which references may refer to, followed by the block.
+        auto encode_block = [&](std::span<const agbpack_u8> data, size_t history_size, size_t block_offset)
         {
-            auto match = match_finder.find_match(current_position);
+            auto write_item = [&](size_t current_position, const match& match)
+            {
+                if (match.length() >= minimum_match_length)
+                {
+                    writer.write_reference(match.length(), match.offset());
+                    record_reference(statistics, match.length(), match.offset());
+                    current_position += match.length();
+                }
+                else
+                {
+                    writer.write_literal(data[current_position]);
+                    record_literal(statistics);
+                    current_position += 1;
+                }
 
-            if (match.length() >= minimum_match_length)
+                recorder.item_written(block_offset + current_position - history_size, writer);
+                reporter.update(block_offset + current_position - history_size);
+            };
+
+            const auto minimum_match_offset = get_minimum_offset(m_vram_safe) - 1; // TODO: unhardcode. What's somewhat ugly: match finders use zero based offfset, whereas global constant uses one based offset
+            if (m_level == 0)
+            {
+                greedy_match_finder match_finder(data, minimum_match_offset);
+                parse_greedy(match_finder, history_size, data.size(), m_nthreads, reporter, block_offset, write_item);
+            }
+            else if (m_level == maximum_level)
             {
-                writer.write_reference(match.length(), match.offset());
-                current_position += match.length();
+                parse_optimal(data, history_size, block_offset, reporter, write_item);
             }
             else
             {
-                writer.write_literal(input[current_position]);
-                current_position += 1;
+                parse_hash_chains(data, history_size, minimum_match_offset, get_search_parameters(m_level), write_item);
             }
-        }
+        };
 
+        // Match finding and output are interleaved, so there is only one phase.
+        measure_phase(statistics, "encode", [&]()
+        {
+            if (dictionary.empty())
+            {
+                for_each_block(input, m_restart_interval, [&](std::span<const agbpack_u8> block, size_t block_offset)
+                {
+                    encode_block(block, 0, block_offset);
+                });
+            }
+            else
+            {
+                vector<agbpack_u8> data(dictionary.begin(), dictionary.end());
+                data.insert(data.end(), input.begin(), input.end());
+                encode_block(data, dictionary.size(), 0);
+            }
+
+            writer.flush();
+        });
+
+        reporter.finish(input.size());
+        record_tag_bytes(statistics);
         return encoded_data;
     }
 
-private:
+    template <typename F>
+    void parse_optimal(std::span<const agbpack_u8> data, size_t history_size, size_t block_offset, progress_reporter& reporter, F f) const
+    {
+        const auto [matches, total_matches] = find_optimal_lzss_matches(data, literal_cost, m_vram_safe ? get_match_cost_vram_safe : get_match_cost, nullptr, reporter, block_offset, history_size);
+        for (const auto& match : std::ranges::subrange(&matches[0], &matches[total_matches]))
+        {
+            if (match.destination >= history_size)
+            {
+                f(match.destination, CLOWNLZSS_MATCH_IS_LITERAL(&match)
+                    ? agbpack::match(1, 0)
+                    : agbpack::match(match.length, match.destination - match.source));
+            }
+        }
+    }
+
+    // Search parameters of levels 1 to 8
+    static const lzss_search_parameters& get_search_parameters(int level)
+    {
+        static constexpr std::array<lzss_search_parameters, 8> parameters =
+        {{
+            // Chain length, nice match length, maximum lazy match length
+            { 4, 8, 0 },
+            { 8, 16, 0 },
+            { 32, maximum_match_length, 0 },
+            { 16, 16, 8 },
+            { 32, maximum_match_length, maximum_match_length },
+            { 128, maximum_match_length, maximum_match_length },
+            { 512, maximum_match_length, maximum_match_length },
+            { maximum_offset, maximum_match_length, maximum_match_length }
+        }};
+
+        return parameters[static_cast<size_t>(level - 1)];
+    }
+
     bool m_vram_safe = false;
+    size_t m_restart_interval = 0;
+    unsigned int m_nthreads = 1;
+    int m_level = default_level;
+    bool m_verify = false;
+    std::shared_ptr<encode_progress> m_progress;
 };
 
 export class optimal_lzss_encoder final
@@ -481,17 +1738,24 @@ public:
     template <std::input_iterator InputIterator, typename OutputIterator>
     void encode(InputIterator input, InputIterator eof, OutputIterator output)
     {
-        static_assert_input_type<InputIterator>();
+        encode(input, eof, output, nullptr);
+    }
 
-        const auto uncompressed_data = vector<agbpack_u8>(input, eof);
-        const auto encoded_data = encode_internal(uncompressed_data);
-        const auto header = header::create(lzss_options::reserved, uncompressed_data.size());
+    // Encodes data and records decoder checkpoints into index.
+    // The encoded data is the same as without an index.
+    template <std::input_iterator InputIterator, typename OutputIterator>
+    void encode(InputIterator input, InputIterator eof, OutputIterator output, lzss_index& index)
+    {
+        encode(input, eof, output, &index);
+    }
 
-        // Copy header and encoded data to output
-        unbounded_byte_writer<OutputIterator> writer(output);
-        write32(writer, header.to_uint32_t());
-        write(writer, encoded_data.begin(), encoded_data.end());
-        write_padding_bytes(writer);
+    // Encodes data and collects statistics about the encoded data.
+    // The encoded data is the same as without statistics.
+    template <std::input_iterator InputIterator, typename OutputIterator>
+    void encode(InputIterator input, InputIterator eof, OutputIterator output, lzss_encoder_statistics& statistics)
+    {
+        statistics = {};
+        encode(input, eof, output, nullptr, statistics);
     }
 
     void vram_safe(bool enable)
@@ -504,86 +1768,438 @@ public:
         return m_vram_safe;
     }
 
+    // When restart points are enabled, the data is encoded in independent blocks of restart_interval bytes:
+    // no reference refers to data in front of the block it belongs to. The encoded data is still a single
+    // valid LZSS stream, but it is slightly bigger. If an index is created while encoding, a checkpoint
+    // is recorded at the beginning of each block, which allows the blocks to be decoded in parallel.
+    // 0 disables restart points.
+    void restart_interval(size_t interval)
+    {
+        m_restart_interval = interval;
+    }
+
+    size_t restart_interval() const
+    {
+        return m_restart_interval;
+    }
+
+    // By default the encoder minimizes the size of the encoded data. With a decode cycle weight
+    // greater than 0 it minimizes bits + weight / 1000 * cycles instead, where cycles is the number of
+    // cycles the GBA BIOS is estimated to need for decoding, see lzss_decode_timing. The weight is in
+    // per mille, so a weight of 1000 makes a cycle cost as much as a bit. Since a literal takes 9 bits
+    // but about 20 cycles, cycles dominate from there on. Useful weights are typically below 1000.
+    // The VRAM timing is used if VRAM safe encoding is enabled, the WRAM timing otherwise.
+    // Higher weights result in faster decoding at the expense of bigger encoded data.
+    void decode_cycle_weight(size_t weight)
+    {
+        m_decode_cycle_weight = weight;
+    }
+
+    size_t decode_cycle_weight() const
+    {
+        return m_decode_cycle_weight;
+    }
+
+    // Reports progress to progress and allows encoding to be cancelled through it. nullptr disables this.
+    void progress(std::shared_ptr<encode_progress> progress)
+    {
+        m_progress = std::move(progress);
+    }
+
+    const std::shared_ptr<encode_progress>& progress() const
+    {
+        return m_progress;
+    }
+
+    // Verifies the encoded data before it is written to output, like lzss_encoder::verify.
+    void verify(bool enable)
+    {
+        m_verify = enable;
+    }
+
+    bool verify() const
+    {
+        return m_verify;
+    }
+
 private:
-    vector<agbpack_u8> encode_internal(const vector<agbpack_u8>& uncompressed_data)
+    // Costs passed to clownlzss when the decode cycle weight is not 0.
+    // Costs are multiplied by 8, so that the cost of a tag byte can be distributed evenly among its items.
+    // Weighted cycles are rounded to whole cost units instead of scaling all costs by 1000,
+    // since clownlzss sums costs in size_t, which may be only 32 bits wide.
+    struct weighted_cost_model final
     {
-        if (uncompressed_data.empty())
+        size_t weight;
+        lzss_decode_timing timing;
+        bool vram_safe;
+
+        size_t cost_of_literal() const
         {
-            // Code further on does not work well with zero-sized input.
-            return {};
+            return 8 * size_t{ literal_cost } + weigh(8 * timing.literal + timing.tag);
         }
 
-        const auto [matches, total_matches] = find_optimal_matches(uncompressed_data);
-        return encode_matches(uncompressed_data, matches, total_matches);
+        size_t cost_of_match(size_t distance, size_t length) const
+        {
+            if ((length < minimum_match_length) || (distance < get_minimum_offset(vram_safe)))
+            {
+                return 0;
+            }
+
+            return 8 * size_t{ match_cost } + weigh(8 * (timing.reference + length * timing.reference_byte) + timing.tag);
+        }
+
+        size_t weigh(size_t cycles) const
+        {
+            return (weight * cycles + 500) / 1000;
+        }
+    };
+
+    template <std::input_iterator InputIterator, typename OutputIterator>
+    void encode(InputIterator input, InputIterator eof, OutputIterator output, lzss_index* index)
+    {
+        no_statistics statistics;
+        encode(input, eof, output, index, statistics);
     }
 
-    std::pair<ClownLZSS::Matches, size_t> find_optimal_matches(const vector<agbpack_u8>& uncompressed_data)
+    template <std::input_iterator InputIterator, typename OutputIterator, typename Statistics>
+    void encode(InputIterator input, InputIterator eof, OutputIterator output, lzss_index* index, Statistics& statistics)
     {
-        ClownLZSS::Matches matches;
-        size_t total_matches;
-        auto match_cost_callback = vram_safe() ? get_match_cost_vram_safe : get_match_cost;
+        static_assert_input_type<InputIterator>();
 
-        if (!ClownLZSS::FindOptimalMatches(
-            filler_value,
-            maximum_match_length,
-            maximum_match_distance,
-            nullptr,
-            literal_cost,
-            match_cost_callback,
-            uncompressed_data.data(),
-            bytes_per_value,
-            uncompressed_data.size() / bytes_per_value,
-            &matches,
-            &total_matches,
-            nullptr))
+        const auto uncompressed_data = vector<agbpack_u8>(input, eof);
+        const auto encoded_data = encode_internal(uncompressed_data, index, statistics);
+        if (m_verify)
         {
-            throw encode_exception("optimal LZSS encoding failed. That should not happen, unless the system is extremely low on memory");
+            measure_phase(statistics, "verify", [&]() { verify_lzss_stream(uncompressed_data, encoded_data, {}, m_vram_safe); });
         }
 
-        return std::make_pair(std::move(matches), total_matches);
+        write_lzss_stream(uncompressed_data.size(), encoded_data, output);
     }
 
-    vector<agbpack_u8> encode_matches(const vector<agbpack_u8>& uncompressed_data, const ClownLZSS::Matches& matches, size_t total_matches)
+    template <typename Statistics>
+    vector<agbpack_u8> encode_internal(const vector<agbpack_u8>& uncompressed_data, lzss_index* index, Statistics& statistics)
     {
         vector<agbpack_u8> encoded_data;
+        encoded_data.reserve(lzss_bitstream_writer::maximum_encoded_size(uncompressed_data.size()));
         lzss_bitstream_writer writer(encoded_data);
+        lzss_checkpoint_recorder recorder(index, uncompressed_data, m_restart_interval);
+        progress_reporter reporter(m_progress.get(), uncompressed_data.size());
+
+        // Note: for_each_block does not call us for zero-sized input, which code further on does not handle well.
+        for_each_block(uncompressed_data, m_restart_interval, [&](std::span<const agbpack_u8> block, size_t block_offset)
+        {
+            const auto [matches, total_matches] = measure_phase(statistics, "find matches", [&]() { return find_optimal_matches(block, reporter, block_offset); });
+            measure_phase(statistics, "emit", [&]() { encode_matches(block, block_offset, matches, total_matches, writer, recorder, statistics); });
+        });
+
+        writer.flush();
+        reporter.finish(uncompressed_data.size());
+        record_tag_bytes(statistics);
+        return encoded_data;
+    }
+
+    std::pair<ClownLZSS::Matches, size_t> find_optimal_matches(std::span<const agbpack_u8> uncompressed_data, progress_reporter& reporter, size_t offset)
+    {
+        if (m_decode_cycle_weight)
+        {
+            const weighted_cost_model cost_model{ m_decode_cycle_weight, vram_safe() ? lzss_vram_decode_timing : lzss_wram_decode_timing, vram_safe() };
+            return find_optimal_lzss_matches(uncompressed_data, cost_model.cost_of_literal(), get_weighted_match_cost, &cost_model, reporter, offset);
+        }
+
+        return find_optimal_lzss_matches(uncompressed_data, literal_cost, vram_safe() ? get_match_cost_vram_safe : get_match_cost, nullptr, reporter, offset);
+    }
 
+    template <typename Statistics>
+    static void encode_matches(
+        std::span<const agbpack_u8> uncompressed_data,
+        size_t block_offset,
+        const ClownLZSS::Matches& matches,
+        size_t total_matches,
+        lzss_bitstream_writer& writer,
+        lzss_checkpoint_recorder& recorder,
+        Statistics& statistics)
+    {
         for (const auto& match : std::ranges::subrange(&matches[0], &matches[total_matches]))
         {
             if (CLOWNLZSS_MATCH_IS_LITERAL(&match))
             {
                 writer.write_literal(uncompressed_data[match.destination]);
+                record_literal(statistics);
             }
             else
             {
                 writer.write_reference(match.length, match.destination - match.source);
+                record_reference(statistics, match.length, match.destination - match.source);
             }
+
+            recorder.item_written(block_offset + match.destination + match.length, writer);
         }
+    }
 
-        return encoded_data;
+    static size_t get_weighted_match_cost(const size_t distance, const size_t length, void* const user)
+    {
+        const auto* cost_model = static_cast<const clownlzss_user_data*>(user)->cost_model;
+        return static_cast<const weighted_cost_model*>(cost_model)->cost_of_match(distance, length);
     }
 
-    static size_t get_match_cost(const size_t, const size_t length, void* const)
+    bool m_vram_safe = false;
+    size_t m_restart_interval = 0;
+    size_t m_decode_cycle_weight = 0;
+    bool m_verify = false;
+    std::shared_ptr<encode_progress> m_progress;
+};
+
+export enum class lzss_refinement_level
+{
+    greedy,
+    lazy,
+    optimal
+};
+
+// LZSS encoder for when encoding time is limited, e.g. in interactive tools.
+// Encoding starts with a greedy parse of the data, which is always completed. While time remains,
+// the parse is then refined, first using lazy matching, then using optimal parsing:
+// * Lazy matching emits a literal instead of a reference if there is a sufficiently longer match at the next position.
+//   It uses parse_hash_chains, like lzss_encoder from level 4 on.
+// * Optimal parsing is done by clownlzss in independent windows of optimal_window_size bytes.
+//   References do not cross window boundaries, so in rare cases this can be worse than lazy matching.
+// The deadline is checked regularly between steps of a refinement. When it has passed, the part of
+// the data refined so far is combined with the parse of the previous level for the remaining data.
+// Refinements are only accepted if they do not make the encoded data bigger.
+// Progress is reported for the greedy parse. Refinements only check whether encoding has been cancelled.
+export class anytime_lzss_encoder final
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    static constexpr size_t optimal_window_size = 64 * 1024;
+
+    // Encodes data and returns the refinement level of the encoded data. This is the highest level
+    // that was completed before the deadline and did not make the encoded data bigger.
+    template <std::input_iterator InputIterator, typename OutputIterator>
+    lzss_refinement_level encode(InputIterator input, InputIterator eof, OutputIterator output, clock::time_point deadline)
     {
-        if (length < minimum_match_length)
+        static_assert_input_type<InputIterator>();
+
+        const auto uncompressed_data = vector<agbpack_u8>(input, eof);
+        auto level = lzss_refinement_level::greedy;
+        progress_reporter reporter(m_progress.get(), uncompressed_data.size());
+        const auto minimum_match_offset = get_minimum_offset(m_vram_safe) - 1;
+        auto parse = parse_greedy(greedy_match_finder(uncompressed_data, minimum_match_offset), uncompressed_data.size(), reporter);
+
+        if (refine(parse, parse_lazy(uncompressed_data, minimum_match_offset, deadline, reporter), uncompressed_data.size()))
         {
-            return 0;
+            level = lzss_refinement_level::lazy;
+        }
+
+        if (refine(parse, parse_optimal(uncompressed_data, deadline, reporter), uncompressed_data.size()))
+        {
+            level = lzss_refinement_level::optimal;
+        }
+
+        reporter.finish(uncompressed_data.size());
+
+        const auto encoded_data = write_bitstream(uncompressed_data, parse);
+        if (m_verify)
+        {
+            verify_lzss_stream(uncompressed_data, encoded_data, {}, m_vram_safe);
+        }
+
+        write_lzss_stream(uncompressed_data.size(), encoded_data, output);
+
+        return level;
+    }
+
+    void vram_safe(bool enable)
+    {
+        m_vram_safe = enable;
+    }
+
+    bool vram_safe() const
+    {
+        return m_vram_safe;
+    }
+
+    // Reports progress to progress and allows encoding to be cancelled through it. nullptr disables this.
+    void progress(std::shared_ptr<encode_progress> progress)
+    {
+        m_progress = std::move(progress);
+    }
+
+    const std::shared_ptr<encode_progress>& progress() const
+    {
+        return m_progress;
+    }
+
+    // Verifies the encoded data before it is written to output, like lzss_encoder::verify.
+    void verify(bool enable)
+    {
+        m_verify = enable;
+    }
+
+    bool verify() const
+    {
+        return m_verify;
+    }
+
+private:
+    // Items of an LZSS stream, in order. Matches shorter than minimum_match_length stand for literals.
+    using lzss_parse = vector<match>;
+
+    // Refinement of a parse. Covers the data up to refined_size, which may be less than the size of the data.
+    struct refined_parse final
+    {
+        lzss_parse items;
+        size_t refined_size;
+    };
+
+    static size_t get_item_length(const match& item)
+    {
+        return item.length() >= minimum_match_length ? item.length() : 1;
+    }
+
+    static size_t get_cost(const lzss_parse& parse)
+    {
+        size_t cost = 0;
+        for (const auto& item : parse)
+        {
+            cost += item.length() >= minimum_match_length ? size_t{ match_cost } : size_t{ literal_cost };
         }
 
-        return match_cost;
+        return cost;
     }
 
-    static size_t get_match_cost_vram_safe(const size_t distance, const size_t length, void* const)
+    // Combines a refinement with the rest of parse and replaces parse with the result, unless it is more expensive.
+    // Returns true if the refinement covers all data and has been accepted, that is, if parse is now entirely made up of the refinement.
+    static bool refine(lzss_parse& parse, refined_parse refinement, size_t size)
     {
-        if ((length < minimum_match_length) || (distance < minimum_vram_safe_offset))
+        const bool complete = refinement.refined_size == size;
+
+        // Skip the items of parse covering the refined data. If an item straddles the end
+        // of the refined data, the bytes up to the end of the item are encoded as literals.
+        size_t position = 0;
+        auto item = parse.begin();
+        for (; (item != parse.end()) && (position < refinement.refined_size); ++item)
         {
-            return 0;
+            position += get_item_length(*item);
+        }
+
+        for (auto literal_position = refinement.refined_size; literal_position < position; ++literal_position)
+        {
+            refinement.items.push_back(match(1, 0));
+        }
+
+        refinement.items.insert(refinement.items.end(), item, parse.end());
+
+        if (get_cost(refinement.items) > get_cost(parse))
+        {
+            return false;
+        }
+
+        parse = std::move(refinement.items);
+        return complete;
+    }
+
+    static lzss_parse parse_greedy(const greedy_match_finder& match_finder, size_t size, progress_reporter& reporter)
+    {
+        lzss_parse parse;
+        agbpack::parse_greedy(match_finder, 0, size, 1, reporter, 0, [&](size_t position, const match& match)
+        {
+            parse.push_back(match);
+            reporter.update(position);
+        });
+
+        return parse;
+    }
+
+    static refined_parse parse_lazy(std::span<const agbpack_u8> data, size_t minimum_match_offset, clock::time_point deadline, const progress_reporter& reporter)
+    {
+        // Follow all chain links, so that each match is as long as the one found by the greedy parse
+        static constexpr lzss_search_parameters parameters{ maximum_offset, maximum_match_length, maximum_match_length };
+        constexpr size_t deadline_check_interval = 1024;
+
+        refined_parse refinement{ {}, 0 };
+        size_t next_deadline_check = 0;
+        auto deadline_passed = [&](size_t position)
+        {
+            if (position < next_deadline_check)
+            {
+                return false;
+            }
+
+            reporter.throw_if_cancelled();
+            next_deadline_check = position + deadline_check_interval;
+            return clock::now() >= deadline;
+        };
+
+        parse_hash_chains(data, 0, minimum_match_offset, parameters, [&](size_t position, const match& match)
+        {
+            refinement.items.push_back(match);
+            refinement.refined_size = position + get_item_length(match);
+        }, deadline_passed);
+
+        return refinement;
+    }
+
+    refined_parse parse_optimal(std::span<const agbpack_u8> data, clock::time_point deadline, progress_reporter& reporter) const
+    {
+        refined_parse refinement{ {}, 0 };
+        for_each_block(data, optimal_window_size, [&](std::span<const agbpack_u8> window, size_t window_offset)
+        {
+            if (refinement.refined_size != window_offset)
+            {
+                // The deadline passed while parsing a previous window
+                return;
+            }
+
+            const auto [matches, total_matches] = find_optimal_lzss_matches(window, literal_cost, m_vram_safe ? get_match_cost_vram_safe : get_match_cost, nullptr, reporter, window_offset, 0, deadline);
+            if (!matches)
+            {
+                // The deadline passed while parsing this window. Only the windows completed so far are used.
+                return;
+            }
+
+            for (const auto& match : std::ranges::subrange(&matches[0], &matches[total_matches]))
+            {
+                refinement.items.push_back(CLOWNLZSS_MATCH_IS_LITERAL(&match)
+                    ? agbpack::match(1, 0)
+                    : agbpack::match(match.length, match.destination - match.source));
+            }
+
+            refinement.refined_size += window.size();
+        });
+
+        return refinement;
+    }
+
+    static vector<agbpack_u8> write_bitstream(std::span<const agbpack_u8> data, const lzss_parse& parse)
+    {
+        vector<agbpack_u8> encoded_data;
+        encoded_data.reserve(lzss_bitstream_writer::maximum_encoded_size(data.size()));
+        lzss_bitstream_writer writer(encoded_data);
+
+        size_t position = 0;
+        for (const auto& item : parse)
+        {
+            if (item.length() >= minimum_match_length)
+            {
+                writer.write_reference(item.length(), item.offset());
+            }
+            else
+            {
+                writer.write_literal(data[position]);
+            }
+
+            position += get_item_length(item);
         }
 
-        return match_cost;
+        writer.flush();
+        return encoded_data;
     }
 
     bool m_vram_safe = false;
+    bool m_verify = false;
+    std::shared_ptr<encode_progress> m_progress;
 };
 
 }
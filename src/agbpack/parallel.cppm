@@ -0,0 +1,94 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+export module agbpack:parallel;
+
+namespace agbpack
+{
+
+// Returns the number of threads to use for nthreads requested threads.
+// 0 means one thread per hardware thread.
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+inline unsigned int get_nthreads(unsigned int nthreads)
+{
+    if (nthreads == 0)
+    {
+        nthreads = std::thread::hardware_concurrency();
+    }
+
+    return std::max(nthreads, 1u);
+}
+
+// Runs task(i) for all i in [0, ntasks) on up to nthreads threads.
+// Tasks are handed out to the threads in ascending order of i. The calling thread is one of the threads,
+// so tasks running on it can do things which must only be done on the calling thread, such as reporting progress.
+// If tasks throw, the remaining tasks are skipped and the first exception is rethrown on the calling thread.
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+template <typename Task>
+void run_in_parallel(std::size_t ntasks, unsigned int nthreads, Task task)
+{
+    const auto nworkers = std::min<std::size_t>(get_nthreads(nthreads), ntasks);
+    if (nworkers <= 1)
+    {
+        for (std::size_t i = 0; i < ntasks; ++i)
+        {
+            task(i);
+        }
+
+        return;
+    }
+
+    std::atomic<std::size_t> next_task = 0;
+    std::atomic<bool> failed = false;
+    std::exception_ptr exception;
+    std::mutex exception_mutex;
+
+    auto worker = [&]
+    {
+        for (auto i = next_task++; (i < ntasks) && !failed; i = next_task++)
+        {
+            try
+            {
+                task(i);
+            }
+            catch (...)
+            {
+                std::scoped_lock lock(exception_mutex);
+                if (!exception)
+                {
+                    exception = std::current_exception();
+                }
+
+                failed = true;
+            }
+        }
+    };
+
+    {
+        std::vector<std::jthread> workers;
+        workers.reserve(nworkers - 1);
+        for (std::size_t i = 1; i < nworkers; ++i)
+        {
+            workers.emplace_back(worker);
+        }
+
+        worker();
+    }
+
+    if (exception)
+    {
+        std::rethrow_exception(exception);
+    }
+}
+
+}
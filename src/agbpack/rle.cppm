@@ -3,8 +3,13 @@
 
 module;
 
+#include <array>
 #include <cassert>
+#include <cstddef>
 #include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
 export module agbpack:rle;
@@ -22,22 +27,115 @@ inline constexpr auto max_repeated_run_length = 0x82;
 inline constexpr auto run_type_mask = 0x80;
 inline constexpr auto run_length_mask = 127;
 
+// Decoder state at the beginning of a run.
+// * input_offset: offset of the run's flag byte in the encoded stream, including the header
+// * output_offset: number of bytes of uncompressed data preceding the run
+export class rle_checkpoint final
+{
+public:
+    explicit rle_checkpoint(std::size_t input_offset, std::size_t output_offset)
+        : m_input_offset(input_offset)
+        , m_output_offset(output_offset)
+    {}
+
+    std::size_t input_offset() const { return m_input_offset; }
+
+    std::size_t output_offset() const { return m_output_offset; }
+
+private:
+    std::size_t m_input_offset;
+    std::size_t m_output_offset;
+};
+
+export using rle_index = checkpoint_index<rle_checkpoint>;
+
 export class rle_decoder final
 {
 public:
     template <std::input_iterator InputIterator, typename OutputIterator>
-    void decode(InputIterator input, InputIterator eof, OutputIterator output)
+    decode_result<InputIterator, OutputIterator> decode(InputIterator input, InputIterator eof, OutputIterator output)
+    {
+        static_assert_input_type<InputIterator>();
+
+        byte_reader<InputIterator> reader(input, eof);
+        auto header = parse_header(reader);
+
+        byte_writer<OutputIterator> writer(header.uncompressed_size(), output);
+        decode_runs(reader, writer);
+        parse_padding_bytes(reader);
+        return { reader.input(), writer.output() };
+    }
+
+    // Checks whether the input is valid encoded data without producing any output. Throws decode_exception if it is not.
+    // Returns the position following the end of the encoded stream.
+    template <std::input_iterator InputIterator>
+    InputIterator validate(InputIterator input, InputIterator eof)
     {
         static_assert_input_type<InputIterator>();
 
         byte_reader<InputIterator> reader(input, eof);
+        auto header = parse_header(reader);
+
+        validate_runs(reader, header.uncompressed_size());
+        parse_padding_bytes(reader);
+        return reader.input();
+    }
+
+    // Decodes length bytes of uncompressed data starting at offset.
+    // Decoding starts at the nearest checkpoint in front of offset. The index must have been
+    // created by the RLE encoder when encoding the data. Note that only the data needed to
+    // decode the requested range is checked for errors.
+    template <std::random_access_iterator RandomAccessIterator, typename OutputIterator>
+    void decode_range(RandomAccessIterator input, RandomAccessIterator eof, const rle_index& index, std::size_t offset, std::size_t length, OutputIterator output)
+    {
+        static_assert_input_type<RandomAccessIterator>();
+
+        byte_reader<RandomAccessIterator> header_reader(input, eof);
+        auto header = parse_header(header_reader);
+
+        if ((offset > header.uncompressed_size()) || (length > header.uncompressed_size() - offset))
+        {
+            throw std::out_of_range("range to decode is outside of uncompressed data");
+        }
+
+        std::size_t input_offset = header_size;
+        std::size_t output_offset = 0;
+        auto checkpoint = index.find(offset);
+        if (checkpoint)
+        {
+            if ((checkpoint->input_offset() < header_size) ||
+                (checkpoint->input_offset() > static_cast<std::size_t>(eof - input)) ||
+                (checkpoint->output_offset() > offset) ||
+                (checkpoint->output_offset() > header.uncompressed_size()))
+            {
+                throw std::invalid_argument("invalid RLE checkpoint");
+            }
+
+            input_offset = checkpoint->input_offset();
+            output_offset = checkpoint->output_offset();
+        }
+
+        byte_reader<RandomAccessIterator> reader(input + make_signed(input_offset), eof);
+        byte_range_writer<OutputIterator> writer(header.uncompressed_size(), output_offset, offset, offset + length, output);
+        decode_runs(reader, writer);
+    }
+
+private:
+    template <std::input_iterator InputIterator>
+    static header parse_header(byte_reader<InputIterator>& reader)
+    {
         auto header = header::parse_for_type(compression_type::rle, read32(reader));
         if (!header)
         {
             throw decode_exception();
         }
 
-        byte_writer<OutputIterator> writer(header->uncompressed_size(), output);
+        return *header;
+    }
+
+    template <typename ByteReader, typename ByteWriter>
+    static void decode_runs(ByteReader& reader, ByteWriter& writer)
+    {
         while (!writer.done())
         {
             auto flag = read8(reader);
@@ -59,11 +157,49 @@ public:
                 }
             }
         }
+    }
 
-        parse_padding_bytes(reader);
+    // Like decode_runs, but only counts the bytes runs would produce, and skips literals rather than reading them.
+    template <typename ByteReader>
+    static void validate_runs(ByteReader& reader, std::size_t uncompressed_size)
+    {
+        std::size_t nbytes_decoded = 0;
+        while (nbytes_decoded < uncompressed_size)
+        {
+            auto flag = read8(reader);
+            if (flag & run_type_mask)
+            {
+                nbytes_decoded += (flag & run_length_mask) + min_repeated_run_length;
+                read8(reader);
+            }
+            else
+            {
+                agbpack_u32 n = (flag & run_length_mask) + min_literal_run_length;
+                nbytes_decoded += n;
+                reader.skip(n);
+            }
+
+            if (nbytes_decoded > uncompressed_size)
+            {
+                throw decode_exception();
+            }
+        }
     }
 };
 
+// Statistics collected by rle_encoder.
+export struct rle_encoder_statistics final
+{
+    std::size_t nliteral_runs = 0;
+    std::size_t nrepeated_runs = 0;
+
+    // Number of runs by length. The index is the run length.
+    std::array<std::size_t, max_literal_run_length + 1> literal_run_length_histogram{};
+    std::array<std::size_t, max_repeated_run_length + 1> repeated_run_length_histogram{};
+
+    std::vector<encoder_phase_time> phase_times;
+};
+
 class literal_buffer final
 {
 public:
@@ -83,11 +219,12 @@ public:
         m_buffer.push_back(literal);
     }
 
-    template <typename TByteWriter>
-    void flush_if_not_empty(TByteWriter& writer)
+    template <typename TByteWriter, typename RunCallback>
+    void flush_if_not_empty(TByteWriter& writer, RunCallback run_start)
     {
         if (!m_buffer.empty())
         {
+            run_start(m_buffer.size());
             writer.write8(static_cast<agbpack_u8>(m_buffer.size() - min_literal_run_length));
             write(writer, m_buffer.begin(), m_buffer.end());
             m_buffer.clear();
@@ -103,14 +240,92 @@ export class rle_encoder final
 public:
     template <std::input_iterator InputIterator, typename OutputIterator>
     void encode(InputIterator input, InputIterator eof, OutputIterator output)
+    {
+        encode(input, eof, output, nullptr);
+    }
+
+    // Encodes data and records decoder checkpoints into index.
+    // The encoded data is the same as without an index.
+    template <std::input_iterator InputIterator, typename OutputIterator>
+    void encode(InputIterator input, InputIterator eof, OutputIterator output, rle_index& index)
+    {
+        encode(input, eof, output, &index);
+    }
+
+    // Encodes data and collects statistics about the encoded data.
+    // The encoded data is the same as without statistics.
+    template <std::input_iterator InputIterator, typename OutputIterator>
+    void encode(InputIterator input, InputIterator eof, OutputIterator output, rle_encoder_statistics& statistics)
+    {
+        statistics = {};
+        encode(input, eof, output, nullptr, statistics);
+    }
+
+    // Reports progress to progress and allows encoding to be cancelled through it. nullptr disables this.
+    void progress(std::shared_ptr<encode_progress> progress)
+    {
+        m_progress = std::move(progress);
+    }
+
+    const std::shared_ptr<encode_progress>& progress() const
+    {
+        return m_progress;
+    }
+
+    // When verification is enabled, the encoded data is decoded and compared against the input before it is written to output.
+    // If they differ, encode throws encode_exception. Verification needs the input a second time, so the input is buffered.
+    void verify(bool enable)
+    {
+        m_verify = enable;
+    }
+
+    bool verify() const
+    {
+        return m_verify;
+    }
+
+private:
+    template <std::input_iterator InputIterator, typename OutputIterator>
+    void encode(InputIterator input, InputIterator eof, OutputIterator output, rle_index* index)
+    {
+        no_statistics statistics;
+        encode(input, eof, output, index, statistics);
+    }
+
+    template <std::input_iterator InputIterator, typename OutputIterator, typename Statistics>
+    void encode(InputIterator input, InputIterator eof, OutputIterator output, rle_index* index, Statistics& statistics)
     {
         static_assert_input_type<InputIterator>();
 
+        if (!m_verify)
+        {
+            encode_stream(input, eof, output, index, statistics);
+            return;
+        }
+
+        const std::vector<agbpack_u8> uncompressed_data(input, eof);
+        std::vector<agbpack_u8> encoded_data;
+        encode_stream(uncompressed_data.begin(), uncompressed_data.end(), back_inserter(encoded_data), index, statistics);
+        measure_phase(statistics, "verify", [&]()
+        {
+            verify_encoded_data(uncompressed_data, [&](byte_verifier& verifier)
+            {
+                rle_decoder().decode(encoded_data.begin(), encoded_data.end(), verifying_output_iterator(verifier));
+            });
+        });
+
+        unbounded_byte_writer<OutputIterator> writer(output);
+        write(writer, encoded_data.begin(), encoded_data.end());
+    }
+
+    template <std::input_iterator InputIterator, typename OutputIterator, typename Statistics>
+    void encode_stream(InputIterator input, InputIterator eof, OutputIterator output, rle_index* index, Statistics& statistics)
+    {
         // We have to encode to a temporary buffer first, because
         // * We don't know yet how many bytes of input there are, so we don't know the header content yet
         // * If the output iterator does not provide random access we cannot output encoded data first and fix up the header last
         std::vector<agbpack_u8> tmp;
-        auto uncompressed_size = encode_internal(input, eof, back_inserter(tmp));
+        auto uncompressed_size = measure_phase(statistics, "encode", [&]() { return encode_internal(input, eof, back_inserter(tmp), index, statistics); });
 
         auto header = header::create(rle_options::reserved, uncompressed_size);
 
@@ -120,16 +335,57 @@ public:
         write(writer, tmp.begin(), tmp.end());
     }
 
-private:
-    template <typename InputIterator, std::output_iterator<agbpack_io_datatype> OutputIterator>
-    agbpack_u32 encode_internal(InputIterator input, InputIterator eof, OutputIterator output)
+    template <typename InputIterator, std::output_iterator<agbpack_io_datatype> OutputIterator, typename Statistics>
+    agbpack_u32 encode_internal(InputIterator input, InputIterator eof, OutputIterator output, rle_index* index, Statistics& statistics)
     {
         literal_buffer literal_buffer;
+        progress_reporter reporter(m_progress.get(), get_size_if_known(input, eof));
         byte_reader<InputIterator> reader(input, eof);
         unbounded_byte_writer<OutputIterator> writer(output);
 
+        // Record a checkpoint at the beginning of a run if one is due
+        std::size_t nbytes_encoded = 0;
+        auto run_start = [&](std::size_t run_length)
+        {
+            if (index && index->checkpoint_due(nbytes_encoded))
+            {
+                index->add(rle_checkpoint(header_size + writer.nbytes_written(), nbytes_encoded));
+            }
+
+            nbytes_encoded += run_length;
+        };
+
+        auto literal_run_start = [&](std::size_t run_length)
+        {
+            if constexpr (collects_statistics<Statistics>)
+            {
+                ++statistics.nliteral_runs;
+                ++statistics.literal_run_length_histogram[run_length];
+            }
+
+            run_start(run_length);
+        };
+
+        auto repeated_run_start = [&](std::size_t run_length)
+        {
+            if constexpr (collects_statistics<Statistics>)
+            {
+                ++statistics.nrepeated_runs;
+                ++statistics.repeated_run_length_histogram[run_length];
+            }
+
+            run_start(run_length);
+        };
+
+        if (index)
+        {
+            index->clear();
+        }
+
         while (!reader.eof())
         {
+            reporter.update(reader.nbytes_read());
+
             // Find longest run of repeated bytes, but not longer than the maximum repeated run length.
             auto byte = reader.read8();
             int run_length = 1;
@@ -148,7 +404,7 @@ private:
                     literal_buffer.add(byte);
                     if (literal_buffer.size() == max_literal_run_length)
                     {
-                        literal_buffer.flush_if_not_empty(writer);
+                        literal_buffer.flush_if_not_empty(writer, literal_run_start);
                     }
                 }
             }
@@ -157,17 +413,22 @@ private:
                 // Encode repeated run.
                 // There may still be buffered literals in the literal buffer, so flush that first.
                 assert((min_repeated_run_length <= run_length) && (run_length <= max_repeated_run_length));
-                literal_buffer.flush_if_not_empty(writer);
+                literal_buffer.flush_if_not_empty(writer, literal_run_start);
+                repeated_run_start(static_cast<std::size_t>(run_length));
                 writer.write8(static_cast<agbpack_u8>(run_type_mask | (run_length - min_repeated_run_length)));
                 writer.write8(byte);
             }
         }
 
-        literal_buffer.flush_if_not_empty(writer);
+        literal_buffer.flush_if_not_empty(writer, literal_run_start);
 
         write_padding_bytes(writer);
+        reporter.finish(reader.nbytes_read());
         return reader.nbytes_read();
     }
+
+    bool m_verify = false;
+    std::shared_ptr<encode_progress> m_progress;
 };
 
 }
@@ -0,0 +1,215 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <utility>
+#include <vector>
+
+export module agbpack:solid;
+import :common;
+import :lzss;
+
+namespace agbpack
+{
+
+using size_t = std::size_t;
+using std::vector;
+
+// MinHash signature of some data: for each of a number of hash functions, the minimum hash of all shingles
+// (sequences of shingle_size bytes) of the data. The fraction of equal values in two signatures estimates
+// the Jaccard similarity of the sets of shingles of the two pieces of data.
+inline constexpr size_t minhash_signature_size = 32;
+inline constexpr size_t minhash_shingle_size = 4;
+using minhash_signature = std::array<agbpack_u32, minhash_signature_size>;
+
+// Finalizer of MurmurHash3
+constexpr agbpack_u32 mix32(agbpack_u32 x)
+{
+    x ^= x >> 16;
+    x *= 0x85ebca6bu;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35u;
+    x ^= x >> 16;
+    return x;
+}
+
+inline minhash_signature get_minhash_signature(std::span<const agbpack_u8> data)
+{
+    minhash_signature signature;
+    signature.fill(std::numeric_limits<agbpack_u32>::max());
+
+    for (size_t i = 0; i + minhash_shingle_size <= data.size(); ++i)
+    {
+        const auto shingle = (agbpack_u32{ data[i] } << 24) | (agbpack_u32{ data[i + 1] } << 16) | (agbpack_u32{ data[i + 2] } << 8) | data[i + 3];
+        for (size_t k = 0; k < signature.size(); ++k)
+        {
+            signature[k] = std::min(signature[k], mix32(shingle + static_cast<agbpack_u32>(k) * 0x9e3779b9u));
+        }
+    }
+
+    return signature;
+}
+
+inline size_t get_similarity(const minhash_signature& a, const minhash_signature& b)
+{
+    size_t similarity = 0;
+    for (size_t k = 0; k < a.size(); ++k)
+    {
+        similarity += a[k] == b[k];
+    }
+
+    return similarity;
+}
+
+// Returns an order of assets in which similar assets are adjacent, as a list of indices into assets.
+// The order starts with the first asset. Each following asset is the remaining asset most similar
+// to its predecessor, judging by MinHash signatures. Ties are broken in favour of the lower index.
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+inline vector<size_t> get_similarity_order(const vector<vector<agbpack_u8>>& assets)
+{
+    vector<minhash_signature> signatures;
+    signatures.reserve(assets.size());
+    std::ranges::transform(assets, std::back_inserter(signatures), [](const auto& asset) { return get_minhash_signature(asset); });
+
+    vector<size_t> order;
+    order.reserve(assets.size());
+    vector<bool> ordered(assets.size(), false);
+    for (size_t next = 0; next < assets.size();)
+    {
+        order.push_back(next);
+        ordered[next] = true;
+
+        const auto& signature = signatures[next];
+        next = assets.size();
+        size_t best_similarity = 0;
+        for (size_t i = 0; i < assets.size(); ++i)
+        {
+            if (ordered[i])
+            {
+                continue;
+            }
+
+            const auto similarity = get_similarity(signature, signatures[i]);
+            if ((next == assets.size()) || (similarity > best_similarity))
+            {
+                next = i;
+                best_similarity = similarity;
+            }
+        }
+    }
+
+    return order;
+}
+
+// Location of an asset within the uncompressed data of a solid LZSS stream.
+export class solid_entry final
+{
+public:
+    explicit solid_entry(size_t offset, size_t size)
+        : m_offset(offset)
+        , m_size(size)
+    {}
+
+    size_t offset() const { return m_offset; }
+
+    size_t size() const { return m_size; }
+
+private:
+    size_t m_offset;
+    size_t m_size;
+};
+
+// Collects small assets and encodes them into a single LZSS stream ("solid" compression).
+// Encoding each asset separately starts each one with an empty sliding window, so redundancy between
+// assets is lost. In a solid stream references can refer to the preceding assets.
+// Writing returns an index which tells where each asset is located within the uncompressed data.
+// An asset can be extracted by decoding the entire stream, or with lzss_decoder::decode_range,
+// which only decodes up to the end of the asset, or less if an lzss_index is passed to it.
+export class solid_lzss_writer final
+{
+public:
+    template <std::input_iterator InputIterator>
+    void add(InputIterator input, InputIterator eof)
+    {
+        static_assert_input_type<InputIterator>();
+        add(vector<agbpack_u8>(input, eof));
+    }
+
+    void add(vector<agbpack_u8> asset)
+    {
+        m_assets.push_back(std::move(asset));
+    }
+
+    size_t size() const
+    {
+        return m_assets.size();
+    }
+
+    // When enabled, assets are stored in an order in which similar assets are adjacent, which makes it more
+    // likely that references can reach similar data. Otherwise assets are stored in the order they were added.
+    // Either way the entries returned by write are in the order in which the assets were added.
+    void order_by_similarity(bool enable)
+    {
+        m_order_by_similarity = enable;
+    }
+
+    bool order_by_similarity() const
+    {
+        return m_order_by_similarity;
+    }
+
+    // Encodes the assets with encoder, which must be an lzss_encoder or an optimal_lzss_encoder.
+    // Returns one entry per asset, in the order in which the assets were added.
+    template <typename LzssEncoder, typename OutputIterator>
+    vector<solid_entry> write(LzssEncoder& encoder, OutputIterator output) const
+    {
+        vector<solid_entry> entries;
+        const auto data = concatenate(entries);
+        encoder.encode(data.begin(), data.end(), output);
+        return entries;
+    }
+
+    // Encodes the assets and records decoder checkpoints into index, see lzss_decoder::decode_range.
+    template <typename LzssEncoder, typename OutputIterator>
+    vector<solid_entry> write(LzssEncoder& encoder, OutputIterator output, lzss_index& index) const
+    {
+        vector<solid_entry> entries;
+        const auto data = concatenate(entries);
+        encoder.encode(data.begin(), data.end(), output, index);
+        return entries;
+    }
+
+private:
+    vector<agbpack_u8> concatenate(vector<solid_entry>& entries) const
+    {
+        vector<size_t> order(m_assets.size());
+        std::iota(order.begin(), order.end(), size_t(0));
+        if (m_order_by_similarity)
+        {
+            order = get_similarity_order(m_assets);
+        }
+
+        vector<agbpack_u8> data;
+        entries.assign(m_assets.size(), solid_entry(0, 0));
+        for (auto i : order)
+        {
+            entries[i] = solid_entry(data.size(), m_assets[i].size());
+            data.insert(data.end(), m_assets[i].begin(), m_assets[i].end());
+        }
+
+        return data;
+    }
+
+    vector<vector<agbpack_u8>> m_assets;
+    bool m_order_by_similarity = false;
+};
+
+}
@@ -26,6 +26,17 @@ int main(int argc, char* argv[])
             return EXIT_FAILURE;
         }
 
+        switch (result.mode)
+        {
+            case agbpacker_core::program_mode::compress:
+                agbpacker_core::compress_file(result);
+                break;
+            case agbpacker_core::program_mode::decompress:
+                // TODO: implement decompression
+                std::cerr << argv[0] << ": decompression is not implemented yet\n";
+                return EXIT_FAILURE;
+        }
+
         return EXIT_SUCCESS;
     }
     catch (const std::exception& e)
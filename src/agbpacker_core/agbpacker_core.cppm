@@ -6,8 +6,11 @@ module;
 #include <string>
 
 export module agbpacker_core;
-export import :compression_method;
 export import :command_line;
+export import :compression_cache;
+export import :compression_method;
+export import :compressor;
+export import :sha256;
 
 namespace agbpacker_core
 {
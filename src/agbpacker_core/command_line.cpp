@@ -3,12 +3,16 @@
 
 module;
 
+#include <charconv>
 #include <cstring> // TODO: see whether to remove this once we've fully implemented compression mode parsing
 #include <format>
 #include <functional> // Required by g++ 15.2
 #include <ranges>
+#include <string_view>
+#include <system_error>
 
 module agbpacker_core;
+import agbpack;
 import argpppp;
 
 namespace agbpacker_core
@@ -59,6 +63,7 @@ string list_compression_methods()
 parse_command_line_result parse_command_line(int argc, char* argv[], bool is_unit_test)
 {
     parse_command_line_result result;
+    bool level_given = false;
 
     auto parse_compression_method = [&](option_occurrence opt)
     {
@@ -81,9 +86,36 @@ parse_command_line_result parse_command_line(int argc, char* argv[], bool is_uni
                 }
             }
 
+            if (level_given && (result.method != compression_method::lzss))
+            {
+                return error(opt, "compression level can only be given for LZSS compression");
+            }
+
             return ok();
     };
 
+    auto parse_level = [&](option_occurrence opt)
+    {
+        using agbpack::lzss_encoder;
+
+        const string_view arg(opt.c_arg());
+        int level = 0;
+        const auto [end, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), level);
+        if ((ec != std::errc()) || (end != arg.data() + arg.size()) || (level < lzss_encoder::minimum_level) || (level > lzss_encoder::maximum_level))
+        {
+            return error(opt, format("compression level must be a number from {} to {}", lzss_encoder::minimum_level, lzss_encoder::maximum_level));
+        }
+
+        if (result.method != compression_method::lzss)
+        {
+            return error(opt, "compression level can only be given for LZSS compression");
+        }
+
+        result.level = level;
+        level_given = true;
+        return ok();
+    };
+
     options command_line_options;
     command_line_options
         .doc("Compress and decompress data for the GBA BIOS\nhttps://github.com/tom42/agbpack\n\nData is LZSS compressed by default if neither of -c or -d is given.")
@@ -96,7 +128,10 @@ parse_command_line_result parse_command_line(int argc, char* argv[], bool is_uni
         .add({ 'c', "compress", format("Compress the input file using the specified compression method. Compression method defaults to 'lzss' if not given. Valid compression methods are: {}", list_compression_methods()), "METHOD", of::arg_optional }, callback(parse_compression_method))
         .add({ 'd', "decompress", "Decompress the input file" }, callback([&] { result.mode = program_mode::decompress; return ok(); }))
         .add({ 'o', "output-file", "Output file name. If not given, input file is overwritten", "FILE" }, value(result.output_file))
-        .add({ {}, "vram-safe", "Use VRAM safe version of compression method if available" }, value(result.vram_safe));
+        .add({ {}, "vram-safe", "Use VRAM safe version of compression method if available" }, value(result.vram_safe))
+        .add({ 'l', "level", format("LZSS compression level. {} to {} trade speed for size: {} is fastest, {} finds an optimal parse. {}, the default, searches the entire sliding window for the longest match at each position, like earlier versions of agbpack", agbpack::lzss_encoder::minimum_level + 1, agbpack::lzss_encoder::maximum_level, agbpack::lzss_encoder::minimum_level + 1, agbpack::lzss_encoder::maximum_level, agbpack::lzss_encoder::default_level), "N" }, callback(parse_level))
+        .add({ {}, "stats", "Print statistics about the compressed data" }, value(result.stats))
+        .add({ {}, "cache-dir", "Look up compressed data in the cache in DIR before compressing, and store it there afterwards", "DIR" }, value(result.cache_directory));
 
     auto parser = make_parser(is_unit_test);
     auto parse_result = parser.parse(argc, argv, command_line_options);
@@ -11,8 +11,7 @@ import :compression_method;
 namespace agbpacker_core
 {
 
-AGBPACK_EXPORT_FOR_UNIT_TESTING
-enum class program_mode
+export enum class program_mode
 {
     compress,
     decompress
@@ -25,8 +24,11 @@ struct parse_command_line_result final
     program_mode mode = program_mode::compress;
     compression_method method = compression_method::lzss;
     bool vram_safe = false;
+    int level = 0; // LZSS compression level, see agbpack::lzss_encoder::level
+    bool stats = false;
     std::string input_file;
     std::string output_file;
+    std::string cache_directory;
 };
 
 export parse_command_line_result parse_command_line(int argc, char* argv[], bool is_unit_test = false);
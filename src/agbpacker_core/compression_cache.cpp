@@ -0,0 +1,255 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+module agbpacker_core;
+
+namespace agbpacker_core
+{
+
+namespace fs = std::filesystem;
+using std::string;
+using std::vector;
+
+namespace
+{
+
+constexpr auto entry_extension = ".agbpack";
+constexpr auto temporary_extension = ".tmp";
+constexpr auto lock_file_name = "lock";
+
+// A lock file or temporary file older than this was left behind by a process that died.
+constexpr auto stale_file_age = std::chrono::minutes(1);
+
+const char* get_name(compression_method method)
+{
+    auto methods = all_compression_methods();
+    auto info = std::ranges::find(methods, method, &compression_method_info::method);
+    return info != methods.end() ? info->name : "unknown";
+}
+
+bool is_stale(const fs::path& path)
+{
+    std::error_code ec;
+    auto time = fs::last_write_time(path, ec);
+    return !ec && (fs::file_time_type::clock::now() - time > stale_file_age);
+}
+
+string make_temporary_file_name(const string& file_name)
+{
+    std::random_device random_device;
+    return std::format("{}.{:08x}{}", file_name, random_device(), temporary_extension);
+}
+
+// Exclusive lock implemented as a file which is created if and only if it does not exist yet.
+// Removing a stale lock file is racy: a process that finds a stale lock file may remove
+// a lock file another process has just created. Two processes may then evict entries at
+// the same time. This is accepted, since eviction tolerates it (see compression_cache::evict).
+class lock_file final
+{
+public:
+    lock_file(const lock_file&) = delete;
+    lock_file& operator=(const lock_file&) = delete;
+
+    explicit lock_file(fs::path path)
+        : m_path(std::move(path))
+    {
+        if (is_stale(m_path))
+        {
+            std::error_code ec;
+            fs::remove(m_path, ec);
+        }
+
+        if (auto file = std::fopen(m_path.string().c_str(), "wx"))
+        {
+            std::fclose(file);
+            m_locked = true;
+        }
+    }
+
+    ~lock_file()
+    {
+        if (m_locked)
+        {
+            std::error_code ec;
+            fs::remove(m_path, ec);
+        }
+    }
+
+    bool locked() const { return m_locked; }
+
+private:
+    fs::path m_path;
+    bool m_locked = false;
+};
+
+}
+
+compression_cache_key::compression_cache_key(const vector<unsigned char>& input, compression_method method, bool vram_safe, int level, string version)
+    : m_input_hash(to_hex_string(sha256(input)))
+    , m_input_size(input.size())
+    , m_method(method)
+    , m_vram_safe(vram_safe)
+    , m_level(method == compression_method::lzss ? level : 0) // Only LZSS compression has levels
+    , m_version(std::move(version))
+{}
+
+string compression_cache_key::file_name() const
+{
+    const auto level = m_method == compression_method::lzss ? std::format("-level{}", m_level) : string();
+    return std::format("{}-{}{}{}-{}", m_input_hash, get_name(m_method), level, m_vram_safe ? "-vram-safe" : "", m_version) + entry_extension;
+}
+
+string compression_cache_key::description() const
+{
+    return std::format("agbpack {} {} {} {} {} {}", m_version, get_name(m_method), m_vram_safe, m_level, m_input_size, m_input_hash);
+}
+
+compression_cache::compression_cache(fs::path directory, std::uintmax_t maximum_size)
+    : m_directory(std::move(directory))
+    , m_maximum_size(maximum_size)
+{
+    std::error_code ec;
+    fs::create_directories(m_directory, ec);
+}
+
+std::optional<vector<unsigned char>> compression_cache::find(const compression_cache_key& key) const
+{
+    const auto path = m_directory / key.file_name();
+    std::ifstream file(path, std::ios::binary);
+
+    string description;
+    if (!std::getline(file, description) || (description != key.description()))
+    {
+        return {};
+    }
+
+    vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (file.bad())
+    {
+        return {};
+    }
+
+    // Mark entry as recently used
+    std::error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+
+    return data;
+}
+
+void compression_cache::store(const compression_cache_key& key, const vector<unsigned char>& data) const
+{
+    const auto path = m_directory / key.file_name();
+    const auto temporary_path = m_directory / make_temporary_file_name(key.file_name());
+
+    {
+        std::ofstream file(temporary_path, std::ios::binary);
+        file << key.description() << '\n';
+        file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!file.flush())
+        {
+            file.close();
+            std::error_code ec;
+            fs::remove(temporary_path, ec);
+            return;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(temporary_path, path, ec);
+    if (ec)
+    {
+        fs::remove(temporary_path, ec);
+        return;
+    }
+
+    evict();
+}
+
+void compression_cache::evict() const
+{
+    lock_file lock(m_directory / lock_file_name);
+    if (!lock.locked())
+    {
+        // Some other process is evicting entries right now
+        return;
+    }
+
+    struct cache_entry final
+    {
+        fs::path path;
+        std::uintmax_t size;
+        fs::file_time_type last_used;
+    };
+
+    vector<cache_entry> entries;
+    std::uintmax_t total_size = 0;
+    std::error_code ec;
+    for (fs::directory_iterator it(m_directory, ec), end; !ec && (it != end); it.increment(ec))
+    {
+        // Entries may be removed by other processes while we iterate, so errors concerning
+        // individual entries are ignored. They must not end the iteration, hence entry_ec.
+        std::error_code entry_ec;
+        const auto& path = it->path();
+        if (path.extension() == temporary_extension)
+        {
+            if (is_stale(path))
+            {
+                fs::remove(path, entry_ec);
+            }
+        }
+        else if (path.extension() == entry_extension)
+        {
+            auto size = it->file_size(entry_ec);
+            if (entry_ec)
+            {
+                continue;
+            }
+
+            auto last_used = it->last_write_time(entry_ec);
+            if (entry_ec)
+            {
+                continue;
+            }
+
+            entries.push_back({ path, size, last_used });
+            total_size += size;
+        }
+    }
+
+    // An entry that no longer exists has been removed by another process evicting entries
+    // at the same time. It still counts as removed, so that no more entries are removed
+    // than if there had been only one process.
+    std::ranges::sort(entries, {}, &cache_entry::last_used);
+    for (const auto& entry : entries)
+    {
+        if (total_size <= m_maximum_size)
+        {
+            break;
+        }
+
+        fs::remove(entry.path, ec);
+        if (!ec)
+        {
+            total_size -= entry.size;
+        }
+    }
+}
+
+}
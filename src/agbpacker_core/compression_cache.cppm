@@ -0,0 +1,73 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+export module agbpacker_core:compression_cache;
+import :compression_method;
+
+namespace agbpacker_core
+{
+
+// Identifies the result of compressing some data: the data plus everything that affects the encoder's output.
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+class compression_cache_key final
+{
+public:
+    explicit compression_cache_key(const std::vector<unsigned char>& input, compression_method method, bool vram_safe, int level, std::string version);
+
+    // Name of the cache entry holding the compressed data. The input data is identified by its SHA-256 hash,
+    // so the key does not need to keep a copy of the input data.
+    std::string file_name() const;
+
+    // Description of everything that identifies the compressed data. This is stored in the cache entry and checked on lookup.
+    std::string description() const;
+
+private:
+    std::string m_input_hash;
+    std::size_t m_input_size;
+    compression_method m_method;
+    bool m_vram_safe;
+    int m_level;
+    std::string m_version;
+};
+
+// On-disk cache of compressed data.
+// * Entries are identified by the SHA-256 hash of the input data and hold only the compressed data.
+// * Entries are written to a temporary file which is then renamed, so readers never see partially written entries.
+// * Entries are touched when they are found. When the cache grows bigger than its maximum size,
+//   least recently used entries are removed. Normally only one process at a time removes entries,
+//   which is ensured by a lock file. Removing a stale lock file is racy, so occasionally two processes
+//   may remove entries at the same time, which is harmless.
+// * The cache is an optimization only: I/O errors result in cache misses and are otherwise ignored.
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+class compression_cache final
+{
+public:
+    static constexpr std::uintmax_t default_maximum_size = 256 * 1024 * 1024;
+
+    explicit compression_cache(std::filesystem::path directory, std::uintmax_t maximum_size = default_maximum_size);
+
+    const std::filesystem::path& directory() const { return m_directory; }
+
+    std::uintmax_t maximum_size() const { return m_maximum_size; }
+
+    std::optional<std::vector<unsigned char>> find(const compression_cache_key& key) const;
+
+    void store(const compression_cache_key& key, const std::vector<unsigned char>& data) const;
+
+private:
+    void evict() const;
+
+    std::filesystem::path m_directory;
+    std::uintmax_t m_maximum_size;
+};
+
+}
@@ -0,0 +1,237 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <chrono>
+#include <cstddef>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "agbpack_config.hpp"
+
+module agbpacker_core;
+import agbpack;
+
+namespace agbpacker_core
+{
+
+using std::format;
+using std::size_t;
+using std::string;
+using std::vector;
+
+namespace
+{
+
+template <typename Encoder>
+vector<unsigned char> encode(Encoder& encoder, const vector<unsigned char>& input)
+{
+    vector<unsigned char> output;
+    encoder.encode(input.begin(), input.end(), back_inserter(output));
+    return output;
+}
+
+template <typename Decoder>
+vector<unsigned char> decode(const vector<unsigned char>& input)
+{
+    Decoder decoder;
+    vector<unsigned char> output;
+    decoder.decode(input.begin(), input.end(), back_inserter(output));
+    return output;
+}
+
+vector<unsigned char> decompress(const vector<unsigned char>& input, compression_method method)
+{
+    switch (method)
+    {
+        case compression_method::lzss:
+            return decode<agbpack::lzss_decoder>(input);
+        case compression_method::rle:
+            return decode<agbpack::rle_decoder>(input);
+        case compression_method::optimal_lzss:
+        case compression_method::h4:
+        case compression_method::h8:
+        case compression_method::d8:
+        case compression_method::d16:
+            // The command line does not accept these methods yet
+            break;
+    }
+
+    throw std::logic_error("invalid compression method");
+}
+
+// Returns the time needed to decompress data. Short decoding times are unreliable,
+// so data is decompressed repeatedly until a minimum amount of time has passed.
+std::chrono::duration<double> measure_decompression_time(const vector<unsigned char>& input, compression_method method)
+{
+    constexpr auto minimum_time = std::chrono::milliseconds(100);
+    const auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::duration::zero();
+    int nruns = 0;
+    do
+    {
+        decompress(input, method);
+        elapsed = std::chrono::steady_clock::now() - start;
+        ++nruns;
+    }
+    while (elapsed < minimum_time);
+
+    return std::chrono::duration<double>(elapsed) / nruns;
+}
+
+double percentage(size_t part, size_t total)
+{
+    return total ? 100.0 * static_cast<double>(part) / static_cast<double>(total) : 0.0;
+}
+
+template <typename Histogram>
+string format_histogram(const Histogram& histogram, size_t total, auto format_index)
+{
+    string s;
+    for (size_t i = 0; i < histogram.size(); ++i)
+    {
+        if (histogram[i])
+        {
+            s += format("  {:>9}: {:>9} ({:5.1f}%)\n", format_index(i), histogram[i], percentage(histogram[i], total));
+        }
+    }
+
+    return s;
+}
+
+string format_lzss_statistics(const vector<unsigned char>& output)
+{
+    agbpack::lzss_decoder_statistics statistics;
+    agbpack::lzss_decoder().decode(output.begin(), output.end(), agbpack::lzss_profiling_receiver(statistics));
+
+    const auto nitems = statistics.nliterals + statistics.nreferences;
+    string s;
+    s += format("Tag bytes:              {:>9}\n", statistics.ntag_bytes);
+    s += format("Literals:               {:>9} ({:5.1f}% of items)\n", statistics.nliterals, percentage(statistics.nliterals, nitems));
+    s += format("References:             {:>9} ({:5.1f}% of items)\n", statistics.nreferences, percentage(statistics.nreferences, nitems));
+    s += format("Referenced bytes:       {:>9} ({:5.1f}% of data)\n", statistics.nbytes - statistics.nliterals, percentage(statistics.nbytes - statistics.nliterals, statistics.nbytes));
+    s += format("VRAM unsafe references: {:>9}\n", statistics.nvram_unsafe_references);
+    s += "Reference lengths:\n";
+    s += format_histogram(statistics.match_length_histogram, statistics.nreferences, [](size_t length) { return format("{}", length); });
+    s += "Reference offsets:\n";
+    s += format_histogram(statistics.match_offset_histogram, statistics.nreferences, [](size_t bit_width)
+    {
+        // Bit width n covers offsets 2^(n-1) to 2^n-1
+        const size_t first = size_t(1) << (bit_width - 1);
+        return first == 1 ? string("1") : format("{}-{}", first, 2 * first - 1);
+    });
+
+    return s;
+}
+
+vector<unsigned char> read_file(const string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("could not open " + path);
+    }
+
+    vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (file.bad())
+    {
+        throw std::runtime_error("could not read " + path);
+    }
+
+    return data;
+}
+
+void write_file(const string& path, const vector<unsigned char>& data)
+{
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!file.flush())
+    {
+        throw std::runtime_error("could not write " + path);
+    }
+}
+
+}
+
+vector<unsigned char> compress(const vector<unsigned char>& input, compression_method method, bool vram_safe, int level)
+{
+    switch (method)
+    {
+        case compression_method::lzss:
+        {
+            agbpack::lzss_encoder encoder;
+            encoder.vram_safe(vram_safe);
+            encoder.level(level);
+            return encode(encoder, input);
+        }
+        case compression_method::rle:
+        {
+            agbpack::rle_encoder encoder;
+            return encode(encoder, input);
+        }
+        case compression_method::optimal_lzss:
+        case compression_method::h4:
+        case compression_method::h8:
+        case compression_method::d8:
+        case compression_method::d16:
+            // The command line does not accept these methods yet
+            break;
+    }
+
+    throw std::logic_error("invalid compression method");
+}
+
+string format_statistics(const vector<unsigned char>& input, const vector<unsigned char>& output, compression_method method)
+{
+    const auto decompression_time = measure_decompression_time(output, method);
+    const auto throughput = decompression_time.count() > 0 ? static_cast<double>(input.size()) / decompression_time.count() / (1024 * 1024) : 0.0;
+
+    string s;
+    s += format("Uncompressed size:      {:>9}\n", input.size());
+    s += format("Compressed size:        {:>9} ({:5.1f}%)\n", output.size(), percentage(output.size(), input.size()));
+    s += format("Decompression time:     {:>9.3f} ms ({:.1f} MiB/s on this host)\n", decompression_time.count() * 1000, throughput);
+
+    if (method == compression_method::lzss)
+    {
+        s += format_lzss_statistics(output);
+    }
+
+    return s;
+}
+
+void compress_file(const parse_command_line_result& options)
+{
+    const auto input = read_file(options.input_file);
+    std::optional<vector<unsigned char>> output;
+
+    if (options.cache_directory.empty())
+    {
+        output = compress(input, options.method, options.vram_safe, options.level);
+    }
+    else
+    {
+        const compression_cache cache(options.cache_directory);
+        const compression_cache_key key(input, options.method, options.vram_safe, options.level, AGBPACK_VERSION);
+        output = cache.find(key);
+        if (!output)
+        {
+            output = compress(input, options.method, options.vram_safe, options.level);
+            cache.store(key, *output);
+        }
+    }
+
+    write_file(options.output_file, *output);
+
+    if (options.stats)
+    {
+        std::cout << format_statistics(input, *output, options.method);
+    }
+}
+
+}
@@ -0,0 +1,25 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <string>
+#include <vector>
+
+export module agbpacker_core:compressor;
+import :command_line;
+import :compression_method;
+
+namespace agbpacker_core
+{
+
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+std::vector<unsigned char> compress(const std::vector<unsigned char>& input, compression_method method, bool vram_safe, int level);
+
+// Describes compressed data: sizes, decoding throughput on the host and, for LZSS, the mix of literals and references.
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+std::string format_statistics(const std::vector<unsigned char>& input, const std::vector<unsigned char>& output, compression_method method);
+
+export void compress_file(const parse_command_line_result& options);
+
+}
@@ -0,0 +1,140 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <span>
+#include <string>
+
+module agbpacker_core;
+
+namespace agbpacker_core
+{
+
+namespace
+{
+
+using block = std::array<unsigned char, 64>;
+using state = std::array<std::uint32_t, 8>;
+
+constexpr std::array<std::uint32_t, 64> round_constants =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+constexpr state initial_state = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+
+void process_block(state& current, const unsigned char* data)
+{
+    std::array<std::uint32_t, 64> w;
+    for (std::size_t i = 0; i < 16; ++i)
+    {
+        w[i] = (std::uint32_t{ data[4 * i] } << 24) | (std::uint32_t{ data[4 * i + 1] } << 16) | (std::uint32_t{ data[4 * i + 2] } << 8) | data[4 * i + 3];
+    }
+
+    for (std::size_t i = 16; i < 64; ++i)
+    {
+        const auto s0 = std::rotr(w[i - 15], 7) ^ std::rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        const auto s1 = std::rotr(w[i - 2], 17) ^ std::rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    auto [a, b, c, d, e, f, g, h] = current;
+    for (std::size_t i = 0; i < 64; ++i)
+    {
+        const auto s1 = std::rotr(e, 6) ^ std::rotr(e, 11) ^ std::rotr(e, 25);
+        const auto ch = (e & f) ^ (~e & g);
+        const auto t1 = h + s1 + ch + round_constants[i] + w[i];
+        const auto s0 = std::rotr(a, 2) ^ std::rotr(a, 13) ^ std::rotr(a, 22);
+        const auto maj = (a & b) ^ (a & c) ^ (b & c);
+        const auto t2 = s0 + maj;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    current[0] += a;
+    current[1] += b;
+    current[2] += c;
+    current[3] += d;
+    current[4] += e;
+    current[5] += f;
+    current[6] += g;
+    current[7] += h;
+}
+
+}
+
+std::array<unsigned char, 32> sha256(std::span<const unsigned char> data)
+{
+    auto current = initial_state;
+
+    const auto nfull_blocks = data.size() / 64;
+    for (std::size_t i = 0; i < nfull_blocks; ++i)
+    {
+        process_block(current, data.data() + 64 * i);
+    }
+
+    // Pad the remaining data with a one bit, zero bits and the length of the data in bits.
+    // This results in either one or two final blocks.
+    std::array<block, 2> final_blocks{};
+    const auto remainder = data.subspan(64 * nfull_blocks);
+    std::ranges::copy(remainder, final_blocks[0].begin());
+    final_blocks[0][remainder.size()] = 0x80;
+
+    const auto nfinal_blocks = remainder.size() < 56 ? 1u : 2u;
+    auto& last_block = final_blocks[nfinal_blocks - 1];
+    const auto nbits = std::uint64_t{ data.size() } * 8;
+    for (std::size_t i = 0; i < 8; ++i)
+    {
+        last_block[63 - i] = static_cast<unsigned char>(nbits >> (8 * i));
+    }
+
+    for (std::size_t i = 0; i < nfinal_blocks; ++i)
+    {
+        process_block(current, final_blocks[i].data());
+    }
+
+    std::array<unsigned char, 32> hash;
+    for (std::size_t i = 0; i < current.size(); ++i)
+    {
+        for (std::size_t j = 0; j < 4; ++j)
+        {
+            hash[4 * i + j] = static_cast<unsigned char>(current[i] >> (24 - 8 * j));
+        }
+    }
+
+    return hash;
+}
+
+std::string to_hex_string(std::span<const unsigned char> hash)
+{
+    std::string s;
+    for (auto byte : hash)
+    {
+        s += std::format("{:02x}", byte);
+    }
+
+    return s;
+}
+
+}
@@ -0,0 +1,23 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include <array>
+#include <span>
+#include <string>
+
+export module agbpacker_core:sha256;
+
+namespace agbpacker_core
+{
+
+// Computes the SHA-256 hash of data as specified in FIPS 180-4.
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+std::array<unsigned char, 32> sha256(std::span<const unsigned char> data);
+
+// Returns a hash as a string of lowercase hexadecimal digits.
+AGBPACK_EXPORT_FOR_UNIT_TESTING
+std::string to_hex_string(std::span<const unsigned char> hash);
+
+}
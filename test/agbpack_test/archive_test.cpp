@@ -0,0 +1,117 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+#include "testdata.hpp"
+
+import agbpack;
+
+namespace agbpack_test
+{
+
+using agbpack::archive_reader;
+using agbpack::archive_writer;
+using agbpack::compression_type;
+using agbpack::decode_exception;
+using byte_vector = std::vector<unsigned char>;
+
+namespace
+{
+
+byte_vector decode_entry(const archive_reader& reader, const char* name)
+{
+    byte_vector output;
+    reader.decode(name, back_inserter(output));
+    return output;
+}
+
+}
+
+TEST_CASE_METHOD(test_data_fixture, "archive_test")
+{
+    archive_writer writer;
+
+    SECTION("Write and read archive")
+    {
+        set_test_data_directory("lzss_encoder");
+        const auto lzss_data = read_decoded_file("lzss.good.delta.cppm");
+        const byte_vector rle_data(77, 'x');
+        const byte_vector delta_data{ 1, 2, 3 };
+        agbpack::lzss_encoder lzss_encoder;
+        agbpack::rle_encoder rle_encoder;
+        agbpack::delta_encoder delta_encoder;
+        writer.add("lzss", encode_vector(lzss_encoder, lzss_data));
+        writer.add("rle", encode_vector(rle_encoder, rle_data));
+        writer.add("delta", encode_vector(delta_encoder, delta_data));
+        CHECK(writer.size() == 3);
+
+        byte_vector archive;
+        writer.write(back_inserter(archive));
+        const archive_reader reader(archive);
+
+        REQUIRE(reader.entries().size() == 3);
+        for (const auto& entry : reader.entries())
+        {
+            CHECK(entry.offset() % 4 == 0);
+        }
+
+        const auto* entry = reader.find("rle");
+        REQUIRE(entry != nullptr);
+        CHECK(entry->type() == compression_type::rle);
+        CHECK(entry->uncompressed_size() == 77);
+        CHECK(byte_vector(reader.stream(*entry).begin(), reader.stream(*entry).end()) == encode_vector(rle_encoder, rle_data));
+
+        CHECK(decode_entry(reader, "lzss") == lzss_data);
+        CHECK(decode_entry(reader, "rle") == rle_data);
+        CHECK(decode_entry(reader, "delta") == delta_data);
+    }
+
+    SECTION("Looking up an entry that does not exist")
+    {
+        byte_vector archive;
+        writer.write(back_inserter(archive));
+        const archive_reader reader(archive);
+
+        CHECK(reader.entries().empty());
+        CHECK(reader.find("foo") == nullptr);
+        CHECK_THROWS_AS(decode_entry(reader, "foo"), std::out_of_range);
+    }
+
+    SECTION("Adding an entry whose name hash is already in use")
+    {
+        const byte_vector data{ 1, 2, 3 };
+        agbpack::rle_encoder encoder;
+        writer.add("foo", encode_vector(encoder, data));
+
+        CHECK_THROWS_AS(writer.add("foo", encode_vector(encoder, data)), std::invalid_argument);
+    }
+
+    SECTION("Adding data without valid header")
+    {
+        CHECK_THROWS_AS(writer.add("foo", byte_vector{ 0, 0 }), std::invalid_argument);
+        CHECK_THROWS_AS(writer.add("foo", byte_vector{ 0, 0, 0, 0 }), std::invalid_argument);
+    }
+
+    SECTION("Reading a truncated archive")
+    {
+        agbpack::rle_encoder encoder;
+        writer.add("foo", encode_vector(encoder, byte_vector{ 1, 2, 3 }));
+        byte_vector archive;
+        writer.write(back_inserter(archive));
+        archive.pop_back();
+
+        CHECK_THROWS_AS(archive_reader(archive), decode_exception);
+    }
+
+    SECTION("Reading something that is not an archive")
+    {
+        const byte_vector archive{ 'f', 'o', 'o', 0, 0, 0, 0, 0 };
+
+        CHECK_THROWS_AS(archive_reader(archive), decode_exception);
+    }
+}
+
+}
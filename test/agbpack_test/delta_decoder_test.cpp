@@ -3,6 +3,8 @@
 
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/generators/catch_generators.hpp>
+#include <iterator>
+#include <vector>
 #include "testdata.hpp"
 
 import agbpack;
@@ -29,6 +31,7 @@ TEST_CASE_METHOD(test_data_fixture, "delta_decoder_test")
         const auto decoded_data = decode_file(decoder, filename);
 
         CHECK(decoded_data == expected_decoded_data);
+        CHECK_NOTHROW(validate_file(decoder, filename));
     }
 
     SECTION("Invalid input")
@@ -44,6 +47,32 @@ TEST_CASE_METHOD(test_data_fixture, "delta_decoder_test")
             "delta.bad.16.missing-padding-at-end-of-data.bin");
 
         CHECK_THROWS_AS(decode_file(decoder, filename), agbpack::decode_exception);
+        CHECK_THROWS_AS(validate_file(decoder, filename), agbpack::decode_exception);
+    }
+
+    SECTION("Decoding streams stored back to back")
+    {
+        const auto first = read_encoded_file("delta.good.8.sine.bin");
+        const auto input = concatenate(first, read_encoded_file("delta.good.16.one-word.bin"));
+        std::vector<unsigned char> decoded_data;
+
+        auto result = decoder.decode(input.begin(), input.end(), back_inserter(decoded_data));
+        CHECK(result.in == input.begin() + std::ssize(first));
+
+        result = decoder.decode(result.in, input.end(), result.out);
+        CHECK(result.in == input.end());
+
+        CHECK(decoded_data == concatenate(read_decoded_file("delta.good.8.sine.bin"), read_decoded_file("delta.good.16.one-word.bin")));
+    }
+
+    SECTION("Validating streams stored back to back")
+    {
+        const auto first = read_encoded_file("delta.good.8.sine.bin");
+        const auto input = concatenate(first, read_encoded_file("delta.good.16.one-word.bin"));
+
+        const auto next = decoder.validate(input.begin(), input.end());
+        CHECK(next == input.begin() + std::ssize(first));
+        CHECK(decoder.validate(next, input.end()) == input.end());
     }
 }
 
@@ -5,7 +5,9 @@
 #include <catch2/generators/catch_generators.hpp>
 #include <catch2/matchers/catch_matchers.hpp>
 #include <catch2/matchers/catch_matchers_exception.hpp>
+#include <memory>
 #include <stdexcept>
+#include <utility>
 #include "testdata.hpp"
 
 import agbpack;
@@ -56,6 +58,55 @@ TEST_CASE_METHOD(test_data_fixture, "delta_encoder_test")
             Catch::Matchers::Message("input must contain an even number of bytes for 16 bit delta encoding"));
     }
 
+    SECTION("Verification is disabled by default")
+    {
+        CHECK(encoder.verify() == false);
+    }
+
+    SECTION("Encoding with verification")
+    {
+        const auto [options, filename] = GENERATE(
+            std::make_pair(agbpack::delta_options::delta8, "delta.good.8.sine.bin"),
+            std::make_pair(agbpack::delta_options::delta16, "delta.good.16.sine.bin"));
+        encoder.options(options);
+        encoder.verify(true);
+
+        CHECK(encode_file(encoder, filename) == read_encoded_file(filename));
+    }
+
+    SECTION("Encoding a file with odd length using 16 bit encoding and verification fails")
+    {
+        encoder.options(agbpack::delta_options::delta16);
+        encoder.verify(true);
+
+        CHECK_THROWS_MATCHES(
+            encode_file(encoder, "delta.bad.16.input-with-odd-length.bin"),
+            agbpack::encode_exception,
+            Catch::Matchers::Message("input must contain an even number of bytes for 16 bit delta encoding"));
+    }
+
+    SECTION("Encoding with progress")
+    {
+        const auto progress = std::make_shared<agbpack::encode_progress>();
+        encoder.progress(progress);
+
+        const auto encoded_data = encode_file(encoder, "delta.good.8.sine.bin");
+
+        CHECK(encoded_data == read_encoded_file("delta.good.8.sine.bin"));
+        CHECK(progress->nbytes_processed() == read_decoded_file("delta.good.8.sine.bin").size());
+        CHECK(progress->nbytes_total() == progress->nbytes_processed());
+    }
+
+    SECTION("Cancelled encoding")
+    {
+        const auto progress = std::make_shared<agbpack::encode_progress>();
+        encoder.progress(progress);
+
+        progress->cancel();
+
+        CHECK_THROWS_AS(encode_file(encoder, "delta.good.8.sine.bin"), agbpack::encode_cancelled_exception);
+    }
+
     SECTION("Invalid options")
     {
         CHECK_THROWS_MATCHES(
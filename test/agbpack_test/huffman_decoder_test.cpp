@@ -5,7 +5,14 @@
 #include <catch2/generators/catch_generators.hpp>
 #include <catch2/matchers/catch_matchers.hpp>
 #include <catch2/matchers/catch_matchers_exception.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <string>
 #include <utility>
+#include <vector>
 #include "testdata.hpp"
 
 import agbpack;
@@ -14,12 +21,20 @@ namespace agbpack_test
 {
 
 using pair = std::pair<const char*, const char*>;
+using size_t = std::size_t;
 
 TEST_CASE_METHOD(test_data_fixture, "huffman_decoder_test")
 {
     agbpack::huffman_decoder decoder;
     set_test_data_directory("huffman_decoder");
 
+    const bool use_table_cache = GENERATE(false, true);
+    INFO(std::format("Test parameters: use_table_cache={}", use_table_cache));
+    if (use_table_cache)
+    {
+        decoder.table_cache(std::make_shared<agbpack::huffman_decoder_table_cache>());
+    }
+
     SECTION("Valid input")
     {
         const auto filename = GENERATE(
@@ -48,6 +63,7 @@ TEST_CASE_METHOD(test_data_fixture, "huffman_decoder_test")
         const auto decoded_data = decode_file(decoder, filename);
 
         CHECK(decoded_data == expected_decoded_data);
+        CHECK_NOTHROW(validate_file(decoder, filename));
     }
 
     SECTION("Invalid input")
@@ -68,6 +84,88 @@ TEST_CASE_METHOD(test_data_fixture, "huffman_decoder_test")
             decode_file(decoder, filename),
             agbpack::decode_exception,
             Catch::Matchers::Message(expected_exception_message));
+
+        CHECK_THROWS_MATCHES(
+            validate_file(decoder, filename),
+            agbpack::decode_exception,
+            Catch::Matchers::Message(expected_exception_message));
+    }
+
+    SECTION("Decoding streams stored back to back")
+    {
+        const auto first = read_encoded_file("huffman.good.8.3-bytes.txt");
+        const auto input = concatenate(first, read_encoded_file("huffman.good.4.256-bytes.bin"));
+        std::vector<unsigned char> decoded_data;
+
+        auto result = decoder.decode(input.begin(), input.end(), back_inserter(decoded_data));
+        CHECK(result.in == input.begin() + std::ssize(first));
+
+        result = decoder.decode(result.in, input.end(), result.out);
+        CHECK(result.in == input.end());
+
+        CHECK(decoded_data == concatenate(read_decoded_file("huffman.good.8.3-bytes.txt"), read_decoded_file("huffman.good.4.256-bytes.bin")));
+    }
+
+    SECTION("Validating streams stored back to back")
+    {
+        const auto first = read_encoded_file("huffman.good.8.3-bytes.txt");
+        const auto input = concatenate(first, read_encoded_file("huffman.good.4.256-bytes.bin"));
+
+        const auto next = decoder.validate(input.begin(), input.end());
+        CHECK(next == input.begin() + std::ssize(first));
+        CHECK(decoder.validate(next, input.end()) == input.end());
+    }
+
+    SECTION("4 bit tree with more than 256 internal nodes")
+    {
+        // Child pairs can be shared, so a tree can have more internal nodes than there are symbols.
+        // In this tree the root node and nodes 2n have nodes 2n+2 and 2n+3 as children.
+        // Nodes 2n+1 have leaf 2n+2 (symbol 0) and node 2n+3 as children. Nodes 508 and 509
+        // have leaves 510 (symbol 1) and 511 (symbol 2). This results in 509 internal nodes.
+        std::vector<unsigned char> encoded_data{ 0x24, 2, 0, 0, 0xff, 0x00 };
+        for (size_t node_index = 2; node_index < 508; node_index += 2)
+        {
+            encoded_data.push_back(0x00);
+            encoded_data.push_back(node_index == 506 ? 0x00 : 0x80);
+        }
+
+        encoded_data.insert(encoded_data.end(), { 0xc0, 0xc0, 1, 2 });
+
+        // Codes: symbol 0 is 10, symbol 1 is 255 zeros and symbol 2 is 254 zeros followed by a one.
+        // Symbols 1, 2, 0, 1 make up the bytes 0x21, 0x10.
+        const auto bits = std::string(255, '0') + std::string(254, '0') + "1" + "10" + std::string(255, '0');
+        for (size_t i = 0; i < bits.size(); i += 32)
+        {
+            std::uint32_t word = 0;
+            for (size_t bit = 0; bit < 32; ++bit)
+            {
+                word = (word << 1) | ((i + bit < bits.size()) && (bits[i + bit] == '1'));
+            }
+
+            for (int shift = 0; shift < 32; shift += 8)
+            {
+                encoded_data.push_back(static_cast<unsigned char>(word >> shift));
+            }
+        }
+
+        CHECK(decode_vector(decoder, encoded_data) == std::vector<unsigned char>{ 0x21, 0x10 });
+    }
+
+    SECTION("Table cache holds one table per tree")
+    {
+        auto cache = std::make_shared<agbpack::huffman_decoder_table_cache>();
+        decoder.table_cache(cache);
+
+        const auto expected_decoded_data = read_decoded_file("huffman.good.8.256-bytes.bin");
+        CHECK(decode_file(decoder, "huffman.good.8.256-bytes.bin") == expected_decoded_data);
+        CHECK(decode_file(decoder, "huffman.good.8.256-bytes.bin") == expected_decoded_data);
+        CHECK(cache->size() == 1);
+
+        CHECK(decode_file(decoder, "huffman.good.4.256-bytes.bin") == read_decoded_file("huffman.good.4.256-bytes.bin"));
+        CHECK(cache->size() == 2);
+
+        CHECK_THROWS_AS(decode_file(decoder, "huffman.bad.8.huffman-tree-access-past-end-of-tree.txt"), agbpack::decode_exception);
+        CHECK(cache->size() == 2);
     }
 }
 
@@ -5,11 +5,18 @@
 #include <catch2/generators/catch_generators.hpp>
 #include <catch2/matchers/catch_matchers.hpp>
 #include <catch2/matchers/catch_matchers_exception.hpp>
+#include <algorithm>
 #include <cstddef>
 #include <format>
+#include <iterator>
+#include <list>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <utility>
+#include <vector>
+#include "test_data_generators.hpp"
 #include "testdata.hpp"
 
 import agbpack;
@@ -88,6 +95,215 @@ TEST_CASE_METHOD(test_data_fixture, "huffman_encoder_test")
         CHECK(decoded_data == original_data);
     }
 
+    SECTION("Automatic options are disabled by default")
+    {
+        CHECK(encoder.automatic_options() == false);
+    }
+
+    SECTION("Encoding with automatic options")
+    {
+        const auto parameters = GENERATE(
+            test_parameters("huffman.good.8.0-bytes.txt", 8, 8),
+            test_parameters("huffman.good.8.2-bytes.txt", 16, 12),
+            test_parameters("huffman.good.8.foo.txt", 52, 44),
+            test_parameters("huffman.good.8.256-bytes-with-same-frequency.bin", 292, 772));
+        INFO(std::format("Test parameters: {}", parameters.filename()));
+        const auto original_data = read_decoded_file(parameters.filename());
+        const auto expected_options = parameters.expected_encoded_size(agbpack::huffman_options::h4) < parameters.expected_encoded_size(agbpack::huffman_options::h8)
+            ? agbpack::huffman_options::h4
+            : agbpack::huffman_options::h8;
+
+        // Encode. The encoder should pick the options producing the smaller output, regardless of its own options.
+        encoder.options(agbpack::huffman_options::h4);
+        encoder.automatic_options(true);
+        const auto encoded_data = encode_vector(encoder, original_data);
+        CHECK(encoded_data.size() == parameters.expected_encoded_size(expected_options));
+
+        // The result should be identical to encoding with the expected options
+        encoder.automatic_options(false);
+        encoder.options(expected_options);
+        CHECK(encoded_data == encode_vector(encoder, original_data));
+
+        // Decode
+        CHECK(decode_vector(decoder, encoded_data) == original_data);
+    }
+
+    SECTION("Encoding with statistics")
+    {
+        const auto options = GENERATE(agbpack::huffman_options::h4, agbpack::huffman_options::h8);
+        const auto symbol_size = options == agbpack::huffman_options::h4 ? 4u : 8u;
+        const auto original_data = read_decoded_file("huffman.good.8.foo.txt");
+        INFO(std::format("Test parameters: symbol_size={}", symbol_size));
+
+        // Encode with statistics. Collecting statistics must not affect the encoded data.
+        encoder.options(options);
+        agbpack::huffman_encoder_statistics statistics;
+        std::vector<unsigned char> encoded_data;
+        encoder.encode(original_data.begin(), original_data.end(), back_inserter(encoded_data), statistics);
+        CHECK(encoded_data == encode_vector(encoder, original_data));
+        CHECK(statistics.options == options);
+
+        // Every symbol has a code. Header, tree and codes padded to 32 bit make up the encoded data.
+        size_t nsymbols = 0;
+        size_t nbits = 0;
+        for (size_t length = 0; length < statistics.code_length_histogram.size(); ++length)
+        {
+            nsymbols += statistics.code_length_histogram[length];
+            nbits += length * statistics.code_length_histogram[length];
+        }
+
+        CHECK(nsymbols == original_data.size() * 8 / symbol_size);
+        CHECK(4 + statistics.tree_size + (nbits + 31) / 32 * 4 == encoded_data.size());
+        CHECK(!statistics.phase_times.empty());
+    }
+
+    SECTION("Encoding contiguous and non-contiguous input yields the same result")
+    {
+        const auto huffman_options = GENERATE(agbpack::huffman_options::h4, agbpack::huffman_options::h8);
+        INFO(std::format("Test parameters: {} bit encoding", std::to_underlying(huffman_options)));
+        const auto original_data = read_decoded_file("huffman.good.8.foo.txt");
+        const std::list<unsigned char> non_contiguous_data(original_data.begin(), original_data.end());
+        encoder.options(huffman_options);
+
+        std::vector<unsigned char> encoded_data;
+        encoder.encode(non_contiguous_data.begin(), non_contiguous_data.end(), back_inserter(encoded_data));
+
+        CHECK(encoded_data == encode_vector(encoder, original_data));
+    }
+
+    SECTION("Encoding with multiple threads yields the same result as encoding with a single thread")
+    {
+        const auto huffman_options = GENERATE(agbpack::huffman_options::h4, agbpack::huffman_options::h8);
+        const auto nthreads = GENERATE(0u, 3u);
+        INFO(std::format("Test parameters: {} bit encoding, nthreads={}", std::to_underlying(huffman_options), nthreads));
+
+        // Input must be big enough to be split into multiple chunks
+        const auto original_data = make_test_data(1024 * 1024 + 7);
+
+        encoder.options(huffman_options);
+        const auto expected_encoded_data = encode_vector(encoder, original_data);
+
+        encoder.nthreads(nthreads);
+        const auto encoded_data = encode_vector(encoder, original_data);
+
+        CHECK(encoded_data == expected_encoded_data);
+        CHECK(decode_vector(decoder, encoded_data) == original_data);
+    }
+
+    SECTION("Verification is disabled by default")
+    {
+        CHECK(encoder.verify() == false);
+    }
+
+    SECTION("Encoding with verification")
+    {
+        const auto huffman_options = GENERATE(agbpack::huffman_options::h4, agbpack::huffman_options::h8);
+        INFO(std::format("Test parameters: {} bit encoding", std::to_underlying(huffman_options)));
+        const auto original_data = read_decoded_file("huffman.good.8.foo.txt");
+        encoder.options(huffman_options);
+        const auto expected_encoded_data = encode_vector(encoder, original_data);
+
+        encoder.verify(true);
+        agbpack::huffman_encoder_statistics statistics;
+        std::vector<unsigned char> encoded_data;
+        encoder.encode(original_data.begin(), original_data.end(), back_inserter(encoded_data), statistics);
+
+        CHECK(encoded_data == expected_encoded_data);
+        CHECK(std::ranges::any_of(statistics.phase_times, [](const auto& phase_time) { return std::string_view(phase_time.name) == "verify"; }));
+    }
+
+    SECTION("Encoding with progress")
+    {
+        const auto nthreads = GENERATE(1u, 3u);
+        INFO(std::format("Test parameters: nthreads={}", nthreads));
+
+        // Input must be big enough for progress to be reported while encoding
+        const auto original_data = make_test_data(1024 * 1024 + 7);
+
+        std::vector<std::pair<size_t, size_t>> reports;
+        encoder.nthreads(nthreads);
+        encoder.progress(std::make_shared<agbpack::encode_progress>([&](size_t nbytes_processed, size_t nbytes_total) { reports.emplace_back(nbytes_processed, nbytes_total); }));
+
+        // Reporting progress must not affect the encoded data
+        const auto encoded_data = encode_vector(encoder, original_data);
+        encoder.progress(nullptr);
+        CHECK(encoded_data == encode_vector(encoder, original_data));
+
+        REQUIRE(reports.size() >= 2);
+        CHECK(reports.front() == std::pair<size_t, size_t>(0, original_data.size()));
+        CHECK(reports.back() == std::pair<size_t, size_t>(original_data.size(), original_data.size()));
+    }
+
+    SECTION("Cancelled encoding")
+    {
+        const auto progress = std::make_shared<agbpack::encode_progress>();
+        encoder.progress(progress);
+
+        progress->cancel();
+
+        CHECK_THROWS_AS(encode_file(encoder, "huffman.good.8.foo.txt"), agbpack::encode_cancelled_exception);
+    }
+
+    SECTION("Encoding with shared tree")
+    {
+        const auto huffman_options = GENERATE(agbpack::huffman_options::h4, agbpack::huffman_options::h8);
+        INFO(std::format("Test parameters: {} bit encoding", std::to_underlying(huffman_options)));
+        const std::vector<std::vector<unsigned char>> corpus_data =
+        {
+            read_decoded_file("huffman.good.8.helloworld.txt"),
+            read_decoded_file("huffman.good.8.foo.txt")
+        };
+        agbpack::huffman_corpus corpus(huffman_options);
+        for (const auto& data : corpus_data)
+        {
+            corpus.add(data.begin(), data.end());
+        }
+        const auto shared_tree = corpus.create_tree();
+        encoder.options(huffman_options);
+
+        // Encode data of the corpus and data with symbols not in the corpus
+        auto original_data = corpus_data;
+        original_data.push_back(read_decoded_file("huffman.good.8.256-bytes-with-same-frequency.bin"));
+        for (const auto& data : original_data)
+        {
+            std::vector<unsigned char> encoded_data;
+            encoder.encode(data.begin(), data.end(), back_inserter(encoded_data), shared_tree);
+            CHECK(decode_vector(decoder, encoded_data) == data);
+
+            const auto comparison = shared_tree.compare(data.begin(), data.end());
+            CHECK(comparison.shared_tree_encoded_size == encoded_data.size());
+            CHECK(comparison.own_tree_encoded_size == encode_vector(encoder, data).size());
+        }
+    }
+
+    SECTION("Encoding with shared tree created for different options")
+    {
+        const auto shared_tree = agbpack::huffman_corpus(agbpack::huffman_options::h4).create_tree();
+        const std::vector<unsigned char> data{ 1, 2, 3 };
+        std::vector<unsigned char> encoded_data;
+        encoder.options(agbpack::huffman_options::h8);
+
+        CHECK_THROWS_MATCHES(
+            encoder.encode(data.begin(), data.end(), back_inserter(encoded_data), shared_tree),
+            std::invalid_argument,
+            Catch::Matchers::Message("shared tree was created for different huffman compression options"));
+    }
+
+    SECTION("Encoding with shared tree and automatic options uses the options of the tree")
+    {
+        const auto shared_tree = agbpack::huffman_corpus(agbpack::huffman_options::h4).create_tree();
+        const std::vector<unsigned char> data{ 1, 2, 3 };
+        std::vector<unsigned char> encoded_data;
+        encoder.options(agbpack::huffman_options::h8);
+        encoder.automatic_options(true);
+
+        encoder.encode(data.begin(), data.end(), back_inserter(encoded_data), shared_tree);
+
+        REQUIRE(!encoded_data.empty());
+        CHECK((encoded_data[0] & 15) == 4);
+        CHECK(decode_vector(decoder, encoded_data) == data);
+    }
+
     SECTION("Invalid options")
     {
         CHECK_THROWS_MATCHES(
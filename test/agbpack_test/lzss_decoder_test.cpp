@@ -8,7 +8,9 @@
 #include <cstddef>
 #include <filesystem>
 #include <format>
+#include <iterator>
 #include <string>
+#include <vector>
 #include "testdata.hpp"
 
 import agbpack;
@@ -81,6 +83,7 @@ TEST_CASE_METHOD(test_data_fixture, "lzss_decoder_test")
 
         CHECK(decode_file(decoder, filename) == expected_decoded_data);
         CHECK(decode_file_to_random_access_iterator(decoder, filename, *this) == expected_decoded_data);
+        CHECK_NOTHROW(validate_file(decoder, filename));
     }
 
     SECTION("Invalid input")
@@ -109,6 +112,11 @@ TEST_CASE_METHOD(test_data_fixture, "lzss_decoder_test")
             decode_file_to_random_access_iterator(decoder, filename, *this),
             agbpack::decode_exception,
             Catch::Matchers::Message(expected_exception_message));
+
+        CHECK_THROWS_MATCHES(
+            validate_file(decoder, filename),
+            agbpack::decode_exception,
+            Catch::Matchers::Message(expected_exception_message));
     }
 
     SECTION("VRAM safe decoding is disabled by default")
@@ -134,6 +142,104 @@ TEST_CASE_METHOD(test_data_fixture, "lzss_decoder_test")
             decode_vector(decoder, not_vram_safe_encoded_data),
             agbpack::decode_exception,
             Catch::Matchers::Message("encoded data is corrupt: encoded data is not VRAM safe"));
+        CHECK_THROWS_MATCHES(
+            decoder.validate(not_vram_safe_encoded_data.begin(), not_vram_safe_encoded_data.end()),
+            agbpack::decode_exception,
+            Catch::Matchers::Message("encoded data is corrupt: encoded data is not VRAM safe"));
+    }
+
+    SECTION("Decoding streams stored back to back")
+    {
+        const auto first = read_encoded_file("lzss.good.literals-and-references.txt");
+        const auto input = concatenate(first, read_encoded_file("lzss.good.17-literals.txt"));
+        std::vector<unsigned char> decoded_data;
+
+        auto result = decoder.decode(input.begin(), input.end(), back_inserter(decoded_data));
+        CHECK(result.in == input.begin() + std::ssize(first));
+
+        result = decoder.decode(result.in, input.end(), result.out);
+        CHECK(result.in == input.end());
+
+        CHECK(decoded_data == concatenate(read_decoded_file("lzss.good.literals-and-references.txt"), read_decoded_file("lzss.good.17-literals.txt")));
+    }
+
+    SECTION("Validating streams stored back to back")
+    {
+        const auto first = read_encoded_file("lzss.good.literals-and-references.txt");
+        const auto input = concatenate(first, read_encoded_file("lzss.good.17-literals.txt"));
+
+        const auto next = decoder.validate(input.begin(), input.end());
+        CHECK(next == input.begin() + std::ssize(first));
+        CHECK(decoder.validate(next, input.end()) == input.end());
+    }
+
+    SECTION("Decoding to random access iterator returns end of decoded data")
+    {
+        const auto encoded_data = read_encoded_file("lzss.good.literals-and-references.txt");
+        std::vector<unsigned char> decoded_data(read_decoded_file("lzss.good.literals-and-references.txt").size());
+
+        const auto result = decoder.decode(encoded_data.begin(), encoded_data.end(), decoded_data.begin());
+
+        CHECK(result.in == encoded_data.end());
+        CHECK(result.out == decoded_data.end());
+    }
+
+    SECTION("Decoding with dictionary")
+    {
+        const auto [filename, expected_decoded_data] = GENERATE(
+            pair("lzss.bad.reference-at-beginning-of-file.txt", "zzz"),
+            pair("lzss.bad.reference-outside-of-non-empty-sliding-window.txt", "abczab"));
+        INFO(std::format("Test parameters: {}", filename));
+        const auto encoded_data = read_encoded_file(filename);
+        const std::vector<unsigned char> dictionary{ 'x', 'y', 'z' };
+
+        std::vector<unsigned char> decoded_data;
+        decoder.decode(encoded_data.begin(), encoded_data.end(), dictionary, back_inserter(decoded_data));
+
+        const string expected(expected_decoded_data);
+        CHECK(decoded_data == std::vector<unsigned char>(expected.begin(), expected.end()));
+    }
+
+    SECTION("Decoding with dictionary throws if a reference is outside of the dictionary")
+    {
+        // Reference with length 3 and offset 3 at the beginning of the data
+        const std::vector<unsigned char> encoded_data{ 0x10, 0x03, 0x00, 0x00, 0x80, 0x00, 0x02, 0x00 };
+        const std::vector<unsigned char> dictionary{ 'y', 'z' };
+        std::vector<unsigned char> decoded_data;
+
+        CHECK_THROWS_MATCHES(
+            decoder.decode(encoded_data.begin(), encoded_data.end(), dictionary, back_inserter(decoded_data)),
+            agbpack::decode_exception,
+            Catch::Matchers::Message("encoded data is corrupt: reference outside of sliding window"));
+    }
+
+    SECTION("Decoding with profiling receiver")
+    {
+        // Two literals, a reference with length 18 and offset 1 and another literal
+        const auto encoded_data = read_encoded_file("lzss.good.reference-with-maximum-match-length.txt");
+
+        agbpack::lzss_decoder_statistics statistics;
+        const auto result = decoder.decode(encoded_data.begin(), encoded_data.end(), agbpack::lzss_profiling_receiver(statistics));
+
+        CHECK(result.in == encoded_data.end());
+        CHECK(statistics.nbytes == 21);
+        CHECK(statistics.ntag_bytes == 1);
+        CHECK(statistics.nliterals == 3);
+        CHECK(statistics.nreferences == 1);
+        CHECK(statistics.match_length_histogram[18] == 1);
+        CHECK(statistics.match_offset_histogram[1] == 1);
+        CHECK(statistics.nvram_unsafe_references == 1);
+    }
+
+    SECTION("Estimating decode cycles")
+    {
+        // Two literals, a reference with length 18 and offset 1 and another literal
+        const auto encoded_data = read_encoded_file("lzss.good.reference-with-maximum-match-length.txt");
+        constexpr agbpack::lzss_decode_timing timing{ 1, 10, 100, 1000, 10000 };
+
+        const auto cycles = agbpack::estimate_lzss_decode_cycles(encoded_data.begin(), encoded_data.end(), timing);
+
+        CHECK(cycles == timing.setup + timing.tag + 3 * timing.literal + timing.reference + 18 * timing.reference_byte);
     }
 }
 
@@ -1,11 +1,24 @@
 // SPDX-FileCopyrightText: 2025 Thomas Mathys
 // SPDX-License-Identifier: MIT
 
+#include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_template_test_macros.hpp>
+#include <catch2/catch_test_macros.hpp>
 #include <catch2/generators/catch_generators.hpp>
+#include <catch2/generators/catch_generators_range.hpp>
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
 #include <format>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
 #include <tuple>
+#include <utility>
+#include <vector>
+#include "test_data_generators.hpp"
 #include "testdata.hpp"
 
 import agbpack;
@@ -14,8 +27,13 @@ namespace agbpack_test
 {
 
 using size_t = std::size_t;
+using agbpack::anytime_lzss_encoder;
+using agbpack::encode_cancelled_exception;
+using agbpack::encode_progress;
 using agbpack::lzss_decoder;
 using agbpack::lzss_encoder;
+using agbpack::lzss_index;
+using agbpack::lzss_refinement_level;
 using agbpack::optimal_lzss_encoder;
 
 namespace
@@ -115,6 +133,476 @@ TEMPLATE_LIST_TEST_CASE_METHOD(
         const auto decoded_data = decode_vector(decoder, vram_safe_encoded_data);
         CHECK(decoded_data == original_data);
     }
+
+    SECTION("Verification is disabled by default")
+    {
+        CHECK(encoder.verify() == false);
+    }
+
+    SECTION("Encoding with verification")
+    {
+        const auto vram_safe = GENERATE(false, true);
+        INFO(std::format("Test parameters: vram_safe={}", vram_safe));
+        const auto original_data = this->read_decoded_file("lzss.good.delta.cppm");
+        encoder.vram_safe(vram_safe);
+        const auto expected_encoded_data = encode_vector(encoder, original_data);
+
+        encoder.verify(true);
+        agbpack::lzss_encoder_statistics statistics;
+        std::vector<unsigned char> encoded_data;
+        encoder.encode(original_data.begin(), original_data.end(), back_inserter(encoded_data), statistics);
+
+        CHECK(encoded_data == expected_encoded_data);
+        CHECK(std::ranges::any_of(statistics.phase_times, [](const auto& phase_time) { return std::string_view(phase_time.name) == "verify"; }));
+    }
+
+    SECTION("Encoding with checkpoint index")
+    {
+        using range = std::pair<size_t, size_t>;
+        const auto original_data = this->read_decoded_file("lzss.good.delta.cppm");
+        const auto [offset, length] = GENERATE(
+            range(0, 0),
+            range(0, 4548),
+            range(100, 20),
+            range(255, 2),
+            range(700, 1500),
+            range(4500, 48),
+            range(4548, 0));
+        INFO(std::format("Test parameters: offset={}, length={}", offset, length));
+
+        // Encode with index. The index must not affect the encoded data.
+        lzss_index index(256);
+        std::vector<unsigned char> encoded_data;
+        encoder.encode(original_data.begin(), original_data.end(), back_inserter(encoded_data), index);
+        CHECK(encoded_data == encode_vector(encoder, original_data));
+        CHECK(index.checkpoints().size() == 17);
+
+        // Decode range
+        std::vector<unsigned char> decoded_data;
+        decoder.decode_range(encoded_data.begin(), encoded_data.end(), index, offset, length, back_inserter(decoded_data));
+        CHECK(decoded_data == slice(original_data, offset, length));
+    }
+
+    SECTION("Restart points are disabled by default")
+    {
+        CHECK(encoder.restart_interval() == 0);
+    }
+
+    SECTION("Encoding with restart points")
+    {
+        const auto original_data = this->read_decoded_file("lzss.good.delta.cppm");
+        const auto nthreads = GENERATE(0u, 1u, 3u);
+        INFO(std::format("Test parameters: nthreads={}", nthreads));
+
+        // Encode with restart points. This should be bigger than encoding without restart points.
+        const auto reference_size = encode_vector(encoder, original_data).size();
+        lzss_index index;
+        std::vector<unsigned char> encoded_data;
+        encoder.restart_interval(1024);
+        encoder.encode(original_data.begin(), original_data.end(), back_inserter(encoded_data), index);
+        CHECK(encoded_data.size() > reference_size);
+
+        // There should be a checkpoint without window at every restart point
+        REQUIRE(index.checkpoints().size() == 4);
+        for (size_t i = 0; i < index.checkpoints().size(); ++i)
+        {
+            CHECK(index.checkpoints()[i].output_offset() == (i + 1) * 1024);
+            CHECK(index.checkpoints()[i].window().empty());
+        }
+
+        // The encoded data must still be a single valid stream
+        CHECK(decode_vector(decoder, encoded_data) == original_data);
+
+        // Decode in parallel
+        std::vector<unsigned char> decoded_data(original_data.size());
+        decoder.decode_parallel(encoded_data.begin(), encoded_data.end(), index, decoded_data.begin(), nthreads);
+        CHECK(decoded_data == original_data);
+    }
+
+    SECTION("Encoding with statistics")
+    {
+        const auto original_data = this->read_decoded_file("lzss.good.delta.cppm");
+
+        // Encode with statistics. Collecting statistics must not affect the encoded data.
+        agbpack::lzss_encoder_statistics statistics;
+        std::vector<unsigned char> encoded_data;
+        encoder.encode(original_data.begin(), original_data.end(), back_inserter(encoded_data), statistics);
+        CHECK(encoded_data == encode_vector(encoder, original_data));
+
+        // Every input byte is either a literal or part of a reference
+        size_t nreferenced_bytes = 0;
+        for (size_t length = 0; length < statistics.match_length_histogram.size(); ++length)
+        {
+            nreferenced_bytes += length * statistics.match_length_histogram[length];
+        }
+        CHECK(statistics.nliterals + nreferenced_bytes == original_data.size());
+        CHECK(std::accumulate(statistics.match_length_histogram.begin(), statistics.match_length_histogram.end(), size_t(0)) == statistics.nreferences);
+        CHECK(std::accumulate(statistics.match_offset_histogram.begin(), statistics.match_offset_histogram.end(), size_t(0)) == statistics.nreferences);
+
+        // Tag bytes, literals and references plus header and padding make up the encoded data
+        const auto nencoded_bytes = 4 + statistics.ntag_bytes + statistics.nliterals + 2 * statistics.nreferences;
+        CHECK((nencoded_bytes + 3) / 4 * 4 == encoded_data.size());
+        CHECK(!statistics.phase_times.empty());
+    }
+
+    SECTION("Progress is not reported by default")
+    {
+        CHECK(encoder.progress() == nullptr);
+    }
+
+    SECTION("Encoding with progress")
+    {
+        // Input must be big enough for progress to be reported while encoding
+        const auto original_data = make_test_data(160 * 1024);
+
+        std::vector<std::pair<size_t, size_t>> reports;
+        encoder.progress(std::make_shared<encode_progress>([&](size_t nbytes_processed, size_t nbytes_total) { reports.emplace_back(nbytes_processed, nbytes_total); }));
+
+        // Reporting progress must not affect the encoded data
+        const auto encoded_data = encode_vector(encoder, original_data);
+        encoder.progress(nullptr);
+        CHECK(encoded_data == encode_vector(encoder, original_data));
+
+        // Progress is reported at the beginning, while encoding and at the end
+        REQUIRE(reports.size() > 2);
+        CHECK(reports.front() == std::pair<size_t, size_t>(0, original_data.size()));
+        CHECK(reports.back() == std::pair<size_t, size_t>(original_data.size(), original_data.size()));
+        CHECK(std::ranges::is_sorted(reports));
+    }
+
+    SECTION("Encoding cancelled before encoding")
+    {
+        const auto original_data = this->read_decoded_file("lzss.good.delta.cppm");
+        const auto progress = std::make_shared<encode_progress>();
+        encoder.progress(progress);
+
+        progress->cancel();
+
+        CHECK_THROWS_AS(encode_vector(encoder, original_data), encode_cancelled_exception);
+    }
+
+    SECTION("Encoding cancelled while encoding")
+    {
+        const auto original_data = make_test_data(160 * 1024);
+
+        std::shared_ptr<encode_progress> progress;
+        progress = std::make_shared<encode_progress>([&](size_t nbytes_processed, size_t) { if (nbytes_processed > 0) { progress->cancel(); } });
+        encoder.progress(progress);
+
+        CHECK_THROWS_AS(encode_vector(encoder, original_data), encode_cancelled_exception);
+        CHECK(progress->nbytes_processed() < original_data.size());
+    }
+}
+
+TEST_CASE("lzss_encoder_test_nthreads", "[lzss]")
+{
+    lzss_encoder encoder;
+    lzss_decoder decoder;
+
+    SECTION("Single thread is used by default")
+    {
+        CHECK(encoder.nthreads() == 1);
+    }
+
+    SECTION("Encoding with multiple threads yields the same result as encoding with a single thread")
+    {
+        const auto nthreads = GENERATE(0u, 3u);
+        const auto restart_interval = GENERATE(size_t(0), size_t(100000));
+        INFO(std::format("Test parameters: nthreads={}, restart_interval={}", nthreads, restart_interval));
+
+        // Input must be big enough to be split into multiple chunks
+        const auto original_data = make_test_data(256 * 1024 + 7);
+
+        encoder.restart_interval(restart_interval);
+        const auto expected_encoded_data = encode_vector(encoder, original_data);
+
+        encoder.nthreads(nthreads);
+        const auto encoded_data = encode_vector(encoder, original_data);
+
+        CHECK(encoded_data == expected_encoded_data);
+        CHECK(decode_vector(decoder, encoded_data) == original_data);
+    }
+
+    SECTION("Encoding with multiple threads reports progress on the calling thread")
+    {
+        const auto restart_interval = GENERATE(size_t(0), size_t(100000));
+        INFO(std::format("Test parameters: restart_interval={}", restart_interval));
+
+        const auto original_data = make_test_data(256 * 1024 + 7);
+
+        const auto calling_thread = std::this_thread::get_id();
+        std::vector<size_t> reports;
+        bool reported_on_other_thread = false;
+        encoder.progress(std::make_shared<encode_progress>([&](size_t nbytes_processed, size_t)
+        {
+            reports.push_back(nbytes_processed);
+            reported_on_other_thread |= std::this_thread::get_id() != calling_thread;
+        }));
+        encoder.restart_interval(restart_interval);
+        encoder.nthreads(3);
+
+        encode_vector(encoder, original_data);
+
+        CHECK(!reported_on_other_thread);
+        CHECK(reports.size() > 2);
+        CHECK(reports.back() == original_data.size());
+        CHECK(std::ranges::is_sorted(reports));
+    }
+}
+
+TEST_CASE_METHOD(test_data_fixture, "lzss_encoder_test_level", "[lzss]")
+{
+    lzss_encoder encoder;
+    lzss_decoder decoder;
+    set_test_data_directory("lzss_encoder");
+
+    SECTION("Level is 0 by default")
+    {
+        CHECK(encoder.level() == 0);
+    }
+
+    SECTION("Invalid level")
+    {
+        CHECK_THROWS_AS(encoder.level(-1), std::invalid_argument);
+        CHECK_THROWS_AS(encoder.level(10), std::invalid_argument);
+    }
+
+    SECTION("Encoding with level")
+    {
+        const auto level = GENERATE(range(lzss_encoder::minimum_level, lzss_encoder::maximum_level + 1));
+        const auto vram_safe = GENERATE(false, true);
+        const auto restart_interval = GENERATE(size_t(0), size_t(1000));
+        INFO(std::format("Test parameters: level={}, vram_safe={}, restart_interval={}", level, vram_safe, restart_interval));
+        const auto original_data = read_decoded_file("lzss.good.delta.cppm");
+        encoder.level(level);
+        encoder.vram_safe(vram_safe);
+        encoder.restart_interval(restart_interval);
+        decoder.vram_safe(vram_safe);
+
+        const auto encoded_data = encode_vector(encoder, original_data);
+
+        CHECK(decode_vector(decoder, encoded_data) == original_data);
+    }
+
+    SECTION("Higher levels produce smaller output")
+    {
+        const auto original_data = read_decoded_file("lzss.good.delta.cppm");
+
+        encoder.level(1);
+        const auto level1_size = encode_vector(encoder, original_data).size();
+        encoder.level(8);
+        const auto level8_size = encode_vector(encoder, original_data).size();
+
+        CHECK(level8_size < level1_size);
+    }
+
+    SECTION("Level 9 yields the same result as optimal_lzss_encoder")
+    {
+        const auto original_data = read_decoded_file("lzss.good.delta.cppm");
+        optimal_lzss_encoder optimal_encoder;
+        encoder.level(9);
+
+        CHECK(encode_vector(encoder, original_data) == encode_vector(optimal_encoder, original_data));
+    }
+}
+
+TEST_CASE_METHOD(test_data_fixture, "lzss_encoder_verify_benchmark", "[.benchmark]")
+{
+    set_test_data_directory("lzss_encoder");
+    const auto original_data = read_decoded_file("lzss.good.delta.cppm");
+    lzss_encoder encoder;
+
+    for (int level : { 0, 1, 9 })
+    {
+        encoder.level(level);
+
+        encoder.verify(false);
+        BENCHMARK(std::format("Level {}", level))
+        {
+            return encode_vector(encoder, original_data);
+        };
+
+        encoder.verify(true);
+        BENCHMARK(std::format("Level {} with verification", level))
+        {
+            return encode_vector(encoder, original_data);
+        };
+    }
+}
+
+TEST_CASE_METHOD(test_data_fixture, "lzss_encoder_test_dictionary", "[lzss]")
+{
+    lzss_encoder encoder;
+    lzss_decoder decoder;
+    set_test_data_directory("lzss_encoder");
+
+    auto encode = [&](const std::vector<unsigned char>& data, const std::vector<unsigned char>& dictionary)
+    {
+        std::vector<unsigned char> encoded_data;
+        encoder.encode(data.begin(), data.end(), dictionary, back_inserter(encoded_data));
+        return encoded_data;
+    };
+
+    auto decode = [&](const std::vector<unsigned char>& encoded_data, const std::vector<unsigned char>& dictionary)
+    {
+        std::vector<unsigned char> decoded_data;
+        decoder.decode(encoded_data.begin(), encoded_data.end(), dictionary, back_inserter(decoded_data));
+        return decoded_data;
+    };
+
+    SECTION("Encoding with dictionary")
+    {
+        const auto level = GENERATE(range(lzss_encoder::minimum_level, lzss_encoder::maximum_level + 1));
+        const auto vram_safe = GENERATE(false, true);
+        INFO(std::format("Test parameters: level={}, vram_safe={}", level, vram_safe));
+        const auto original_data = read_decoded_file("lzss.good.delta.cppm");
+        const auto dictionary = change_every_nth_byte(original_data, 500); // Previous version of the data
+        encoder.level(level);
+        encoder.vram_safe(vram_safe);
+        decoder.vram_safe(vram_safe);
+
+        const auto encoded_data = encode(original_data, dictionary);
+
+        CHECK(encoded_data.size() < encode_vector(encoder, original_data).size());
+        CHECK(decode(encoded_data, dictionary) == original_data);
+    }
+
+    SECTION("Encoding with empty dictionary yields the same result as encoding without dictionary")
+    {
+        const auto level = GENERATE(0, 1, 9);
+        INFO(std::format("Test parameters: level={}", level));
+        const auto original_data = read_decoded_file("lzss.good.delta.cppm");
+        encoder.level(level);
+
+        CHECK(encode(original_data, {}) == encode_vector(encoder, original_data));
+    }
+
+    SECTION("Only the last 4096 bytes of the dictionary are used")
+    {
+        const auto original_data = read_decoded_file("lzss.good.delta.cppm");
+        const auto dictionary = change_every_nth_byte(original_data, 500);
+        const auto dictionary_tail = std::vector<unsigned char>(dictionary.end() - 4096, dictionary.end());
+
+        const auto encoded_data = encode(original_data, dictionary);
+
+        CHECK(encoded_data == encode(original_data, dictionary_tail));
+        CHECK(decode(encoded_data, dictionary) == original_data);
+        CHECK(decode(encoded_data, dictionary_tail) == original_data);
+    }
+
+    SECTION("Zero length input")
+    {
+        const auto dictionary = change_every_nth_byte(read_decoded_file("lzss.good.delta.cppm"), 500);
+
+        const auto encoded_data = encode({}, dictionary);
+
+        CHECK(encoded_data == encode_vector(encoder, std::vector<unsigned char>()));
+        CHECK(decode(encoded_data, dictionary).empty());
+    }
+
+    SECTION("Encoding with dictionary and verification")
+    {
+        const auto original_data = read_decoded_file("lzss.good.delta.cppm");
+        const auto dictionary = change_every_nth_byte(original_data, 500);
+        const auto expected_encoded_data = encode(original_data, dictionary);
+
+        encoder.verify(true);
+
+        CHECK(encode(original_data, dictionary) == expected_encoded_data);
+    }
+
+    SECTION("Restart points cannot be used together with a dictionary")
+    {
+        encoder.restart_interval(1000);
+
+        CHECK_THROWS_AS(encode(read_decoded_file("lzss.good.delta.cppm"), { 1, 2, 3 }), std::invalid_argument);
+    }
+}
+
+TEST_CASE_METHOD(test_data_fixture, "anytime_lzss_encoder_test", "[lzss]")
+{
+    anytime_lzss_encoder encoder;
+    lzss_decoder decoder;
+    set_test_data_directory("lzss_encoder");
+
+    auto encode = [&](const std::vector<unsigned char>& data, anytime_lzss_encoder::clock::time_point deadline, lzss_refinement_level& level)
+    {
+        std::vector<unsigned char> encoded_data;
+        level = encoder.encode(data.begin(), data.end(), back_inserter(encoded_data), deadline);
+        return encoded_data;
+    };
+
+    SECTION("Expired deadline")
+    {
+        const auto vram_safe = GENERATE(false, true);
+        INFO(std::format("Test parameters: vram_safe={}", vram_safe));
+        const auto original_data = read_decoded_file("lzss.good.delta.cppm");
+        lzss_encoder greedy_encoder;
+        greedy_encoder.vram_safe(vram_safe);
+        encoder.vram_safe(vram_safe);
+        decoder.vram_safe(vram_safe);
+
+        // The greedy parse is always completed, so the result should be at least as good as the greedy encoder's
+        lzss_refinement_level level;
+        const auto encoded_data = encode(original_data, anytime_lzss_encoder::clock::now(), level);
+        CHECK(level == lzss_refinement_level::greedy);
+        CHECK(encoded_data.size() <= encode_vector(greedy_encoder, original_data).size());
+
+        CHECK(decode_vector(decoder, encoded_data) == original_data);
+    }
+
+    SECTION("Deadline far in the future")
+    {
+        const auto vram_safe = GENERATE(false, true);
+        INFO(std::format("Test parameters: vram_safe={}", vram_safe));
+        const auto original_data = read_decoded_file("lzss.good.delta.cppm");
+        optimal_lzss_encoder optimal_encoder;
+        optimal_encoder.vram_safe(vram_safe);
+        encoder.vram_safe(vram_safe);
+        decoder.vram_safe(vram_safe);
+
+        // The data fits into a single optimal parsing window, so the result should be the same as the optimal encoder's
+        lzss_refinement_level level;
+        const auto encoded_data = encode(original_data, anytime_lzss_encoder::clock::now() + std::chrono::hours(1), level);
+        CHECK(level == lzss_refinement_level::optimal);
+        CHECK(encoded_data == encode_vector(optimal_encoder, original_data));
+
+        CHECK(decode_vector(decoder, encoded_data) == original_data);
+    }
+
+    SECTION("Zero length input")
+    {
+        lzss_refinement_level level;
+        const auto encoded_data = encode({}, anytime_lzss_encoder::clock::now() + std::chrono::hours(1), level);
+        CHECK(level == lzss_refinement_level::optimal);
+        CHECK(encoded_data.size() == 4);
+    }
+
+    SECTION("Encoding with verification")
+    {
+        const auto vram_safe = GENERATE(false, true);
+        INFO(std::format("Test parameters: vram_safe={}", vram_safe));
+        const auto original_data = read_decoded_file("lzss.good.delta.cppm");
+        encoder.vram_safe(vram_safe);
+        encoder.verify(true);
+
+        lzss_refinement_level level;
+        const auto encoded_data = encode(original_data, anytime_lzss_encoder::clock::now(), level);
+
+        CHECK(decode_vector(decoder, encoded_data) == original_data);
+    }
+
+    SECTION("Cancelled encoding")
+    {
+        const auto original_data = read_decoded_file("lzss.good.delta.cppm");
+        const auto progress = std::make_shared<encode_progress>();
+        encoder.progress(progress);
+
+        progress->cancel();
+
+        lzss_refinement_level level;
+        CHECK_THROWS_AS(encode(original_data, anytime_lzss_encoder::clock::now() + std::chrono::hours(1), level), encode_cancelled_exception);
+    }
 }
 
 }
@@ -35,6 +35,7 @@ TEST_CASE_METHOD(test_data_fixture, "rle_decoder_test")
         const auto decoded_data = decode_file(decoder, filename);
 
         CHECK(decoded_data == expected_decoded_data);
+        CHECK_NOTHROW(validate_file(decoder, filename));
     }
 
     SECTION("Invalid input")
@@ -52,6 +53,32 @@ TEST_CASE_METHOD(test_data_fixture, "rle_decoder_test")
             "rle.bad.missing-padding-at-end-of-data.txt");
 
         CHECK_THROWS_AS(decode_file(decoder, filename), agbpack::decode_exception);
+        CHECK_THROWS_AS(validate_file(decoder, filename), agbpack::decode_exception);
+    }
+
+    SECTION("Decoding streams stored back to back")
+    {
+        const auto first = read_encoded_file("rle.good.foo.txt");
+        const auto input = concatenate(first, read_encoded_file("rle.good.3-repeated-bytes.txt"));
+        std::vector<unsigned char> decoded_data;
+
+        auto result = decoder.decode(input.begin(), input.end(), back_inserter(decoded_data));
+        CHECK(result.in == input.begin() + std::ssize(first));
+
+        result = decoder.decode(result.in, input.end(), result.out);
+        CHECK(result.in == input.end());
+
+        CHECK(decoded_data == concatenate(read_decoded_file("rle.good.foo.txt"), read_decoded_file("rle.good.3-repeated-bytes.txt")));
+    }
+
+    SECTION("Validating streams stored back to back")
+    {
+        const auto first = read_encoded_file("rle.good.foo.txt");
+        const auto input = concatenate(first, read_encoded_file("rle.good.3-repeated-bytes.txt"));
+
+        const auto next = decoder.validate(input.begin(), input.end());
+        CHECK(next == input.begin() + std::ssize(first));
+        CHECK(decoder.validate(next, input.end()) == input.end());
     }
 
     SECTION("Input from ifstream")
@@ -3,6 +3,12 @@
 
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/generators/catch_generators.hpp>
+#include <cstddef>
+#include <format>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 #include "testdata.hpp"
 
 import agbpack;
@@ -41,6 +47,109 @@ TEST_CASE_METHOD(test_data_fixture, "rle_encoder_test")
 
         CHECK(encoded_data == expected_encoded_data);
     }
+
+    SECTION("Verification is disabled by default")
+    {
+        CHECK(encoder.verify() == false);
+    }
+
+    SECTION("Encoding with verification")
+    {
+        const auto filename = GENERATE(
+            "rle.good.zero-length-file.txt",
+            "rle.good.foo.txt",
+            "rle.good.very-long-literal-run.txt",
+            "rle.good.very-long-repeated-run.txt");
+        encoder.verify(true);
+
+        CHECK(encode_file(encoder, filename) == read_encoded_file(filename));
+    }
+
+    SECTION("Encoding with checkpoint index")
+    {
+        using range = std::pair<std::size_t, std::size_t>;
+        const auto original_data = read_decoded_file("rle.good.foo.txt");
+        const auto [offset, length] = GENERATE(range(0, 0), range(0, 3), range(2, 20), range(30, 7), range(40, 5));
+        INFO(std::format("Test parameters: offset={}, length={}", offset, length));
+        agbpack::rle_decoder decoder;
+
+        // Encode with index. The index must not affect the encoded data.
+        agbpack::rle_index index(8);
+        std::vector<unsigned char> encoded_data;
+        encoder.encode(original_data.begin(), original_data.end(), back_inserter(encoded_data), index);
+        CHECK(encoded_data == read_encoded_file("rle.good.foo.txt"));
+        CHECK(!index.checkpoints().empty());
+
+        // Decode range
+        std::vector<unsigned char> decoded_data;
+        decoder.decode_range(encoded_data.begin(), encoded_data.end(), index, offset, length, back_inserter(decoded_data));
+        CHECK(decoded_data == slice(original_data, offset, length));
+    }
+
+    SECTION("Checkpoints must be added to index in order")
+    {
+        agbpack::rle_index index;
+        index.add(agbpack::rle_checkpoint(4, 10));
+
+        CHECK_THROWS_AS(index.add(agbpack::rle_checkpoint(8, 10)), std::invalid_argument);
+        CHECK_THROWS_AS(index.add(agbpack::rle_checkpoint(8, 9)), std::invalid_argument);
+        CHECK(index.checkpoints().size() == 1);
+    }
+
+    SECTION("Encoding with statistics")
+    {
+        const auto original_data = read_decoded_file("rle.good.foo.txt");
+
+        // Encode with statistics. Collecting statistics must not affect the encoded data.
+        agbpack::rle_encoder_statistics statistics;
+        std::vector<unsigned char> encoded_data;
+        encoder.encode(original_data.begin(), original_data.end(), back_inserter(encoded_data), statistics);
+        CHECK(encoded_data == read_encoded_file("rle.good.foo.txt"));
+
+        // Runs cover the entire input
+        std::size_t nliteral_runs = 0;
+        std::size_t nliteral_bytes = 0;
+        for (std::size_t length = 0; length < statistics.literal_run_length_histogram.size(); ++length)
+        {
+            nliteral_runs += statistics.literal_run_length_histogram[length];
+            nliteral_bytes += length * statistics.literal_run_length_histogram[length];
+        }
+
+        std::size_t nrepeated_runs = 0;
+        std::size_t nrepeated_bytes = 0;
+        for (std::size_t length = 0; length < statistics.repeated_run_length_histogram.size(); ++length)
+        {
+            nrepeated_runs += statistics.repeated_run_length_histogram[length];
+            nrepeated_bytes += length * statistics.repeated_run_length_histogram[length];
+        }
+
+        CHECK(nliteral_runs == statistics.nliteral_runs);
+        CHECK(nrepeated_runs == statistics.nrepeated_runs);
+        CHECK(nliteral_bytes + nrepeated_bytes == original_data.size());
+        CHECK(!statistics.phase_times.empty());
+    }
+
+    SECTION("Encoding with progress")
+    {
+        const auto progress = std::make_shared<agbpack::encode_progress>();
+        encoder.progress(progress);
+
+        const auto encoded_data = encode_file(encoder, "rle.good.foo.txt");
+
+        CHECK(encoded_data == read_encoded_file("rle.good.foo.txt"));
+        CHECK(progress->nbytes_processed() == read_decoded_file("rle.good.foo.txt").size());
+        CHECK(progress->nbytes_total() == progress->nbytes_processed());
+    }
+
+    SECTION("Cancelled encoding")
+    {
+        const auto progress = std::make_shared<agbpack::encode_progress>();
+        encoder.progress(progress);
+
+        progress->cancel();
+
+        CHECK_THROWS_AS(encode_file(encoder, "rle.good.foo.txt"), agbpack::encode_cancelled_exception);
+    }
 }
 
 }
@@ -0,0 +1,176 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <random>
+#include <vector>
+#include "test_data_generators.hpp"
+#include "testdata.hpp"
+
+import agbpack;
+
+namespace agbpack_test
+{
+
+using agbpack::lzss_decoder;
+using agbpack::lzss_encoder;
+using agbpack::lzss_index;
+using agbpack::optimal_lzss_encoder;
+using agbpack::solid_entry;
+using agbpack::solid_lzss_writer;
+using byte_vector = std::vector<unsigned char>;
+using size_t = std::size_t;
+
+namespace
+{
+
+// Splits data into assets of asset_size bytes (the last one may be shorter)
+std::vector<byte_vector> split(const byte_vector& data, size_t asset_size)
+{
+    std::vector<byte_vector> assets;
+    for (size_t offset = 0; offset < data.size(); offset += asset_size)
+    {
+        const auto end = data.begin() + static_cast<std::ptrdiff_t>(std::min(offset + asset_size, data.size()));
+        assets.emplace_back(data.begin() + static_cast<std::ptrdiff_t>(offset), end);
+    }
+
+    return assets;
+}
+
+byte_vector make_random_data(size_t size, unsigned int seed)
+{
+    std::minstd_rand random(seed);
+    byte_vector data(size);
+    for (auto& byte : data)
+    {
+        byte = static_cast<unsigned char>(random() % 16);
+    }
+
+    return data;
+}
+
+byte_vector get_asset(const byte_vector& decoded_data, const solid_entry& entry)
+{
+    const auto begin = decoded_data.begin() + static_cast<std::ptrdiff_t>(entry.offset());
+    return byte_vector(begin, begin + static_cast<std::ptrdiff_t>(entry.size()));
+}
+
+}
+
+TEST_CASE_METHOD(test_data_fixture, "solid_lzss_writer_test")
+{
+    solid_lzss_writer writer;
+    lzss_decoder decoder;
+    set_test_data_directory("lzss_encoder");
+
+    SECTION("Ordering by similarity is disabled by default")
+    {
+        CHECK(writer.order_by_similarity() == false);
+    }
+
+    SECTION("Ordering by similarity can be enabled and disabled")
+    {
+        writer.order_by_similarity(true);
+        CHECK(writer.order_by_similarity() == true);
+
+        writer.order_by_similarity(false);
+        CHECK(writer.order_by_similarity() == false);
+    }
+
+    SECTION("Writing without assets")
+    {
+        lzss_encoder encoder;
+        byte_vector encoded_data;
+
+        const auto entries = writer.write(encoder, back_inserter(encoded_data));
+
+        CHECK(entries.empty());
+        CHECK(decode_vector(decoder, encoded_data).empty());
+    }
+
+    SECTION("Writing assets")
+    {
+        const auto assets = split(read_decoded_file("lzss.good.delta.cppm"), 300);
+        for (const auto& asset : assets)
+        {
+            writer.add(asset.begin(), asset.end());
+        }
+
+        CHECK(writer.size() == assets.size());
+
+        lzss_encoder encoder;
+        byte_vector encoded_data;
+        const auto entries = writer.write(encoder, back_inserter(encoded_data));
+        const auto decoded_data = decode_vector(decoder, encoded_data);
+
+        REQUIRE(entries.size() == assets.size());
+        size_t total_size_of_separately_encoded_assets = 0;
+        for (size_t i = 0; i < assets.size(); ++i)
+        {
+            CHECK(entries[i].offset() == i * 300);
+            CHECK(get_asset(decoded_data, entries[i]) == assets[i]);
+            total_size_of_separately_encoded_assets += encode_vector(encoder, assets[i]).size();
+        }
+
+        CHECK(encoded_data.size() < total_size_of_separately_encoded_assets);
+    }
+
+    SECTION("Writing assets with index and decoding them with decode_range")
+    {
+        const auto assets = split(read_decoded_file("lzss.good.delta.cppm"), 300);
+        for (const auto& asset : assets)
+        {
+            writer.add(asset);
+        }
+
+        optimal_lzss_encoder encoder;
+        lzss_index index(1000);
+        byte_vector encoded_data;
+        const auto entries = writer.write(encoder, back_inserter(encoded_data), index);
+
+        CHECK(!index.checkpoints().empty());
+        for (size_t i = 0; i < assets.size(); ++i)
+        {
+            byte_vector asset;
+            decoder.decode_range(encoded_data.begin(), encoded_data.end(), index, entries[i].offset(), entries[i].size(), back_inserter(asset));
+            CHECK(asset == assets[i]);
+        }
+    }
+
+    SECTION("Ordering by similarity")
+    {
+        // Two pairs of similar assets, added such that the sliding window cannot reach from one asset of a pair to the other
+        const auto a = make_random_data(3000, 1);
+        const auto b = make_random_data(3000, 2);
+        const std::vector<byte_vector> assets{ a, b, change_every_nth_byte(a, 100), change_every_nth_byte(b, 100) };
+        for (const auto& asset : assets)
+        {
+            writer.add(asset);
+        }
+
+        lzss_encoder encoder;
+        byte_vector encoded_data;
+        writer.write(encoder, back_inserter(encoded_data));
+
+        writer.order_by_similarity(true);
+        byte_vector ordered_encoded_data;
+        const auto ordered_entries = writer.write(encoder, back_inserter(ordered_encoded_data));
+        const auto decoded_data = decode_vector(decoder, ordered_encoded_data);
+
+        REQUIRE(ordered_entries.size() == assets.size());
+        CHECK(ordered_entries[0].offset() == 0);
+        CHECK(ordered_entries[2].offset() == 3000);
+        CHECK(ordered_entries[1].offset() == 6000);
+        CHECK(ordered_entries[3].offset() == 9000);
+        for (size_t i = 0; i < assets.size(); ++i)
+        {
+            CHECK(get_asset(decoded_data, ordered_entries[i]) == assets[i]);
+        }
+
+        CHECK(ordered_encoded_data.size() < encoded_data.size());
+    }
+}
+
+}
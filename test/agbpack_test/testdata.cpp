@@ -1,6 +1,7 @@
 // SPDX-FileCopyrightText: 2024 Thomas Mathys
 // SPDX-License-Identifier: MIT
 
+#include <cstddef>
 #include <filesystem>
 #include <iterator>
 #include <system_error>
@@ -75,6 +76,19 @@ std::ifstream open_binary_file(const std::string& path)
     return file;
 }
 
+std::vector<unsigned char> slice(const std::vector<unsigned char>& data, std::size_t offset, std::size_t length)
+{
+    const auto begin = data.begin() + static_cast<std::ptrdiff_t>(offset);
+    return std::vector<unsigned char>(begin, begin + static_cast<std::ptrdiff_t>(length));
+}
+
+std::vector<unsigned char> concatenate(const std::vector<unsigned char>& first, const std::vector<unsigned char>& second)
+{
+    auto data = first;
+    data.insert(data.end(), second.begin(), second.end());
+    return data;
+}
+
 std::string test_data_directory::get_decoded_file_path(const std::string& basename) const
 {
     return (std::filesystem::path(agbpack_test_testdata_directory) / std::filesystem::path(m_directory) / (basename + ".decoded")).string();
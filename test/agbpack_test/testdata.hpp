@@ -4,6 +4,7 @@
 #ifndef AGBPACK_TESTDATA_HPP_20240706
 #define AGBPACK_TESTDATA_HPP_20240706
 
+#include <cstddef>
 #include <fstream>
 #include <string>
 #include <vector>
@@ -15,6 +16,10 @@ std::size_t get_file_size(const std::string& path);
 
 std::ifstream open_binary_file(const std::string& path);
 
+std::vector<unsigned char> slice(const std::vector<unsigned char>& data, std::size_t offset, std::size_t length);
+
+std::vector<unsigned char> concatenate(const std::vector<unsigned char>& first, const std::vector<unsigned char>& second);
+
 template <typename TDecoder>
 std::vector<unsigned char> decode_vector(TDecoder& decoder, const std::vector<unsigned char>& input)
 {
@@ -63,6 +68,13 @@ public:
         return decode_vector(decoder, read_encoded_file(basename));
     }
 
+    template <typename TDecoder>
+    void validate_file(TDecoder& decoder, const std::string& basename) const
+    {
+        const auto input = read_encoded_file(basename);
+        decoder.validate(input.begin(), input.end());
+    }
+
     template <typename TEncoder>
     std::vector<unsigned char> encode_file(TEncoder& encoder, const std::string& basename) const
     {
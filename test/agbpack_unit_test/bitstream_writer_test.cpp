@@ -58,6 +58,25 @@ TEST_CASE("bitstream_writer_test")
         CHECK(output == byte_vector{ 0x78, 0x56, 0x34, 0x12, 0x00, 0x00, 0x00, 0x9a });
     }
 
+    SECTION("Write bits without overflow of the bit buffer")
+    {
+        bitstream_writer.write_code(0b101, 3);
+        bitstream_writer.write_bits(0b11000000'00000000'00000000'00000000, 2);
+        bitstream_writer.flush();
+
+        CHECK(output == byte_vector{ 0, 0, 0, 0b10111000 });
+    }
+
+    SECTION("Write bits, overflow in the middle of the bits")
+    {
+        bitstream_writer.write_code(0x12, 8);
+        bitstream_writer.write_bits(0x3456789a, 32);
+        bitstream_writer.write_bits(0xf0000000, 4);
+        bitstream_writer.flush();
+
+        CHECK(output == byte_vector{ 0x78, 0x56, 0x34, 0x12, 0x00, 0x00, 0xf0, 0x9a });
+    }
+
     SECTION("flush when no data has been written")
     {
         bitstream_writer.flush();
@@ -68,6 +68,27 @@ TEST_CASE("byte_reader_test")
 
         CHECK(reader.nbytes_read() == 2);
     }
+
+    SECTION("skip advances over bytes")
+    {
+        byte_vector input{ 11, 22, 33 };
+        byte_reader reader(begin(input), end(input));
+
+        reader.skip(0);
+        CHECK(reader.nbytes_read() == 0);
+
+        reader.skip(2);
+        CHECK(reader.nbytes_read() == 2);
+        CHECK(reader.read8() == 33);
+    }
+
+    SECTION("skip throws if it goes past EOF")
+    {
+        byte_vector input{ 11, 22 };
+        byte_reader reader(begin(input), end(input));
+
+        CHECK_THROWS_AS(reader.skip(3), decode_exception);
+    }
 }
 
 }
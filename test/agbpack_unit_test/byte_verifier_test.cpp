@@ -0,0 +1,126 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <vector>
+
+import agbpack;
+import agbpack_unit_testkit;
+
+namespace agbpack_unit_test
+{
+
+using agbpack::byte_verifier;
+using agbpack::decode_exception;
+using agbpack::encode_exception;
+using agbpack::verify_encoded_data;
+using agbpack::verifying_output_iterator;
+using byte_vector = std::vector<unsigned char>;
+
+TEST_CASE("byte_verifier_test")
+{
+    const byte_vector expected{ 11, 22, 33 };
+    byte_verifier verifier(expected);
+
+    SECTION("State after creation")
+    {
+        CHECK(verifier.nbytes_verified() == 0);
+    }
+
+    SECTION("Verify expected data")
+    {
+        verifier.verify8(11);
+        verifier.verify8(22);
+        verifier.verify8(33);
+
+        CHECK(verifier.nbytes_verified() == 3);
+        CHECK_NOTHROW(verifier.verify_end());
+    }
+
+    SECTION("verify8 throws if a byte differs from the expected byte")
+    {
+        verifier.verify8(11);
+
+        CHECK_THROWS_AS(verifier.verify8(23), encode_exception);
+    }
+
+    SECTION("verify8 throws if more bytes than expected are verified")
+    {
+        verifier.verify8(11);
+        verifier.verify8(22);
+        verifier.verify8(33);
+
+        CHECK_THROWS_AS(verifier.verify8(0), encode_exception);
+    }
+
+    SECTION("verify_end throws if fewer bytes than expected have been verified")
+    {
+        verifier.verify8(11);
+        verifier.verify8(22);
+
+        CHECK_THROWS_AS(verifier.verify_end(), encode_exception);
+    }
+
+    SECTION("verified_byte")
+    {
+        verifier.verify8(11);
+        verifier.verify8(22);
+
+        CHECK(verifier.verified_byte(1) == 22);
+        CHECK(verifier.verified_byte(2) == 11);
+    }
+
+    SECTION("verified_byte throws if offset is outside of the verified data")
+    {
+        verifier.verify8(11);
+
+        CHECK_THROWS_AS(verifier.verified_byte(0), encode_exception);
+        CHECK_THROWS_AS(verifier.verified_byte(2), encode_exception);
+    }
+}
+
+TEST_CASE("verifying_output_iterator_test")
+{
+    const byte_vector expected{ 11, 22, 33 };
+    byte_verifier verifier(expected);
+
+    SECTION("Bytes written are passed to verifier")
+    {
+        std::ranges::copy(byte_vector{ 11, 22 }, verifying_output_iterator(verifier));
+
+        CHECK(verifier.nbytes_verified() == 2);
+    }
+
+    SECTION("Writing an unexpected byte throws")
+    {
+        CHECK_THROWS_AS(std::ranges::copy(byte_vector{ 11, 0 }, verifying_output_iterator(verifier)), encode_exception);
+    }
+}
+
+TEST_CASE("verify_encoded_data_test")
+{
+    const byte_vector expected{ 11, 22, 33 };
+
+    SECTION("Decoded data equals expected data")
+    {
+        CHECK_NOTHROW(verify_encoded_data(expected, [&](byte_verifier& verifier) { std::ranges::copy(expected, verifying_output_iterator(verifier)); }));
+    }
+
+    SECTION("Decoded data differs from expected data")
+    {
+        CHECK_THROWS_AS(verify_encoded_data(expected, [](byte_verifier& verifier) { std::ranges::copy(byte_vector{ 11, 23, 33 }, verifying_output_iterator(verifier)); }), encode_exception);
+    }
+
+    SECTION("Decoded data is shorter than expected data")
+    {
+        CHECK_THROWS_AS(verify_encoded_data(expected, [](byte_verifier& verifier) { std::ranges::copy(byte_vector{ 11, 22 }, verifying_output_iterator(verifier)); }), encode_exception);
+    }
+
+    SECTION("Decoder throws decode_exception")
+    {
+        CHECK_THROWS_AS(verify_encoded_data(expected, [](byte_verifier&) { throw decode_exception(); }), encode_exception);
+    }
+}
+
+}
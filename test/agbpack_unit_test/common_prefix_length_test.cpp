@@ -0,0 +1,116 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <catch2/generators/catch_generators_range.hpp>
+#include <cstddef>
+#include <format>
+#include <string>
+#include <vector>
+#include "test_data_generators.hpp"
+
+import agbpack;
+import agbpack_unit_testkit;
+
+namespace agbpack_unit_test
+{
+
+using agbpack::common_prefix_length;
+using agbpack::common_prefix_length_scalar;
+using agbpack_test::make_test_data;
+using std::size_t;
+
+namespace
+{
+
+std::vector<unsigned char> make_input(const std::string& s)
+{
+    return std::vector<unsigned char>(s.begin(), s.end());
+}
+
+}
+
+TEST_CASE("common_prefix_length_test")
+{
+    SECTION("No match")
+    {
+        const auto input = make_input("abcd");
+        CHECK(common_prefix_length(input, 2, 1, 18) == 0);
+        CHECK(common_prefix_length(input, 2, 2, 18) == 0);
+    }
+
+    SECTION("Match is limited by maximum length")
+    {
+        const auto input = make_input(std::string(64, 'a'));
+        CHECK(common_prefix_length(input, 1, 1, 0) == 0);
+        CHECK(common_prefix_length(input, 1, 1, 15) == 15);
+        CHECK(common_prefix_length(input, 1, 1, 16) == 16);
+        CHECK(common_prefix_length(input, 1, 1, 18) == 18);
+        CHECK(common_prefix_length(input, 1, 1, 40) == 40);
+    }
+
+    SECTION("Match is limited by end of input")
+    {
+        const auto input = make_input(std::string(20, 'a'));
+        CHECK(common_prefix_length(input, 1, 1, 18) == 18);
+        CHECK(common_prefix_length(input, 4, 1, 18) == 16);
+        CHECK(common_prefix_length(input, 19, 1, 18) == 1);
+        CHECK(common_prefix_length(input, 20, 1, 18) == 0);
+        CHECK(common_prefix_length(input, 21, 1, 18) == 0);
+    }
+
+    SECTION("Match ends at first differing byte")
+    {
+        const auto length = GENERATE(range(size_t(0), size_t(40)));
+        INFO(std::format("Test parameters: length={}", length));
+        auto input = make_input(std::string(2 + 64, 'a'));
+        input[2 + length] = 'b';
+
+        CHECK(common_prefix_length(input, 2, 2, 64) == length);
+        CHECK(common_prefix_length_scalar(input, 2, 2, 64) == length);
+    }
+
+    SECTION("Vectorized version yields same results as scalar version")
+    {
+        const auto input = make_test_data(64 * 1024);
+        for (size_t position = 0; position < 1024; ++position)
+        {
+            for (size_t offset = 1; offset <= position; ++offset)
+            {
+                REQUIRE(common_prefix_length(input, position, offset, 18) == common_prefix_length_scalar(input, position, offset, 18));
+            }
+        }
+    }
+}
+
+TEST_CASE("common_prefix_length_benchmark", "[.benchmark]")
+{
+    const auto input = make_test_data(64 * 1024);
+    auto search_all_offsets = [&](auto kernel)
+    {
+        size_t sum = 0;
+        for (size_t position = 4096; position < 8192; ++position)
+        {
+            for (size_t offset = 1; offset <= 4096; ++offset)
+            {
+                sum += kernel(input, position, offset, 18);
+            }
+        }
+
+        return sum;
+    };
+
+    BENCHMARK("Scalar")
+    {
+        return search_all_offsets(common_prefix_length_scalar);
+    };
+
+    BENCHMARK("Vectorized")
+    {
+        return search_all_offsets(common_prefix_length);
+    };
+}
+
+}
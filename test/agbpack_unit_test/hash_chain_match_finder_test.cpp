@@ -0,0 +1,112 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <cstddef>
+#include <format>
+#include <string>
+#include <vector>
+#include "test_data_generators.hpp"
+
+import agbpack;
+import agbpack_unit_testkit;
+
+namespace agbpack_unit_test
+{
+
+using agbpack::greedy_match_finder;
+using agbpack::hash_chain_match_finder;
+using agbpack::match;
+using agbpack_test::make_test_data;
+using std::size_t;
+
+namespace
+{
+
+constexpr size_t unlimited_chain_length = 1024 * 1024;
+
+match find_match(const std::string& data, size_t current_position, size_t maximum_chain_length, size_t nice_match_length)
+{
+    std::vector<unsigned char> v(data.begin(), data.end());
+    hash_chain_match_finder match_finder(v, 0, maximum_chain_length, nice_match_length);
+    for (size_t position = 0; position < current_position; ++position)
+    {
+        match_finder.insert(position);
+    }
+
+    return match_finder.find_match(current_position);
+}
+
+}
+
+TEST_CASE("hash_chain_match_finder_test")
+{
+    SECTION("Empty input")
+    {
+        CHECK((find_match("", 0, unlimited_chain_length, 18) == match(0, 0)));
+    }
+
+    SECTION("Matches shorter than 3 bytes are not found")
+    {
+        CHECK((find_match("aa", 1, unlimited_chain_length, 18) == match(0, 0)));
+        CHECK((find_match("aaa", 1, unlimited_chain_length, 18) == match(0, 0)));
+        CHECK((find_match("abcab", 3, unlimited_chain_length, 18) == match(0, 0)));
+    }
+
+    SECTION("Reference of length 18 that overlaps with lookahead buffer")
+    {
+        CHECK((find_match("aaaaaaaaaaaaaaaaaaa", 0, unlimited_chain_length, 18) == match(0, 0)));
+        CHECK((find_match("aaaaaaaaaaaaaaaaaaa", 1, unlimited_chain_length, 18) == match(18, 1)));
+    }
+
+    SECTION("If there is more than one match the longer one is returned")
+    {
+        CHECK((find_match("abcdxabcdeyabcdez", 11, unlimited_chain_length, 18) == match(5, 6)));
+    }
+
+    SECTION("Search stops at the maximum chain length")
+    {
+        // The most recent candidate is the short match at offset 6
+        CHECK((find_match("abcdexabcdyabcdez", 11, 1, 18) == match(4, 5)));
+        CHECK((find_match("abcdexabcdyabcdez", 11, 2, 18) == match(5, 11)));
+    }
+
+    SECTION("Search stops at a match of nice length")
+    {
+        CHECK((find_match("abcdexabcdyabcdez", 11, unlimited_chain_length, 4) == match(4, 5)));
+    }
+
+    SECTION("Unlimited search finds matches as long as those found by greedy_match_finder")
+    {
+        const auto minimum_match_offset = GENERATE(size_t(0), size_t(1));
+        INFO(std::format("Test parameters: minimum_match_offset={}", minimum_match_offset));
+
+        // Reduce the alphabet so that there are many matches
+        auto input = make_test_data(20000);
+        for (auto& byte : input)
+        {
+            byte %= 7;
+        }
+
+        greedy_match_finder greedy_finder(input, minimum_match_offset);
+        hash_chain_match_finder hash_chain_finder(input, minimum_match_offset, unlimited_chain_length, 18);
+        for (size_t position = 0; position < input.size(); ++position)
+        {
+            const auto expected_length = greedy_finder.find_match(position).length();
+            const auto length = hash_chain_finder.find_match(position).length();
+            if (expected_length >= 3)
+            {
+                REQUIRE(length == expected_length);
+            }
+            else
+            {
+                REQUIRE(length == 0);
+            }
+
+            hash_chain_finder.insert(position);
+        }
+    }
+}
+
+}
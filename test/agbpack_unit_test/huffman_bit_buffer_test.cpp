@@ -0,0 +1,62 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+#include <catch2/catch_test_macros.hpp>
+#include <iterator>
+#include <vector>
+
+import agbpack;
+import agbpack_unit_testkit;
+
+namespace agbpack_unit_test
+{
+
+using byte_vector = std::vector<unsigned char>;
+
+TEST_CASE("huffman_bit_buffer_test")
+{
+    byte_vector output;
+    agbpack::unbounded_byte_writer byte_writer(back_inserter(output));
+    agbpack::bitstream_writer bitstream_writer(byte_writer);
+    agbpack::huffman_bit_buffer buffer;
+
+    SECTION("Empty buffer")
+    {
+        buffer.flush();
+        buffer.copy_to(bitstream_writer);
+        bitstream_writer.flush();
+
+        CHECK(buffer.nbits() == 0);
+        CHECK(output == byte_vector{});
+    }
+
+    SECTION("Copy buffer to empty bitstream")
+    {
+        buffer.write_code(0x12, 8);
+        buffer.write_code(0x3456789a, 32);
+        buffer.flush();
+        buffer.copy_to(bitstream_writer);
+        bitstream_writer.flush();
+
+        CHECK(buffer.nbits() == 40);
+        CHECK(output == byte_vector{ 0x78, 0x56, 0x34, 0x12, 0x00, 0x00, 0x00, 0x9a });
+    }
+
+    SECTION("Copy buffers to bitstream which is not aligned to 32 bits")
+    {
+        agbpack::huffman_bit_buffer buffer2;
+        bitstream_writer.write_code(0b101, 3);
+        buffer.write_code(0x7fffffff, 31);
+        buffer.flush();
+        buffer2.write_code(0b01, 2);
+        buffer2.flush();
+
+        buffer.copy_to(bitstream_writer);
+        buffer2.copy_to(bitstream_writer);
+        bitstream_writer.flush();
+
+        CHECK(output == byte_vector{ 0xff, 0xff, 0xff, 0xbf, 0x00, 0x00, 0x00, 0xd0 });
+    }
+}
+
+}
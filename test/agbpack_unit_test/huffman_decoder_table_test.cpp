@@ -0,0 +1,126 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers.hpp>
+#include <catch2/matchers/catch_matchers_exception.hpp>
+#include <stdexcept>
+#include <vector>
+
+import agbpack;
+import agbpack_unit_testkit;
+
+namespace agbpack_unit_test
+{
+
+using agbpack::decode_exception;
+using agbpack::huffman_decoder_table;
+using agbpack::huffman_decoder_table_cache;
+using std::vector;
+
+TEST_CASE("huffman_decoder_table_test")
+{
+    SECTION("Valid tree")
+    {
+        const vector<unsigned char> serialized_tree = { 0x01, 0xc0, 0x01, 0x02 };
+
+        const huffman_decoder_table table(4, serialized_tree);
+
+        CHECK(table.symbol_size() == 4);
+    }
+
+    SECTION("State machine for 4 bit symbols")
+    {
+        const vector<unsigned char> serialized_tree = { 0x01, 0xc0, 0x01, 0x02 };
+
+        const huffman_decoder_table table(4, serialized_tree);
+        const auto& transition = table.get_transition(0, 0b10110000);
+
+        CHECK(transition.symbols == 0x11112212);
+        CHECK(transition.nsymbols == 8);
+        CHECK(transition.next_state == 0);
+    }
+
+    SECTION("State machine for 4 bit symbols with transitions ending on internal node")
+    {
+        // Codes: 0 => 1, 10 => 2, 11 => 3
+        const vector<unsigned char> serialized_tree = { 0x02, 0x80, 0x01, 0xc0, 0x02, 0x03 };
+
+        const huffman_decoder_table table(4, serialized_tree);
+        const auto& transition = table.get_transition(0, 0b01011001);
+
+        CHECK(transition.symbols == 0x00011321);
+        CHECK(transition.nsymbols == 5);
+        CHECK(transition.next_state == 1);
+        CHECK(table.get_transition(1, 0b10000000).symbols == 0x11111113);
+    }
+
+    SECTION("Invalid symbol")
+    {
+        const vector<unsigned char> serialized_tree = { 0x01, 0xc0, 0x11, 0x02 };
+
+        CHECK_THROWS_MATCHES(
+            huffman_decoder_table(4, serialized_tree),
+            decode_exception,
+            Catch::Matchers::Message("encoded data is corrupt: huffman tree contains invalid symbol"));
+    }
+
+    SECTION("Access past end of tree")
+    {
+        const vector<unsigned char> serialized_tree = { 0x01, 0x40, 0x01, 0x02 };
+
+        CHECK_THROWS_MATCHES(
+            huffman_decoder_table(8, serialized_tree),
+            decode_exception,
+            Catch::Matchers::Message("encoded data is corrupt"));
+    }
+
+    SECTION("Cache returns the same table for the same tree")
+    {
+        const vector<unsigned char> serialized_tree = { 0x01, 0xc0, 0x01, 0x02 };
+        huffman_decoder_table_cache cache;
+
+        const auto table1 = cache.get(8, serialized_tree);
+        const auto table2 = cache.get(8, serialized_tree);
+        const auto table3 = cache.get(4, serialized_tree);
+
+        CHECK(table1 == table2);
+        CHECK(table1 != table3);
+        CHECK(cache.size() == 2);
+
+        cache.clear();
+        CHECK(cache.size() == 0);
+    }
+
+    SECTION("Cache evicts tables when it is full")
+    {
+        const vector<unsigned char> serialized_tree = { 0x01, 0xc0, 0x01, 0x02 };
+        huffman_decoder_table_cache cache;
+        CHECK(cache.maximum_size() == huffman_decoder_table_cache::default_maximum_size);
+
+        cache.maximum_size(1);
+        const auto table1 = cache.get(8, serialized_tree);
+        const auto table2 = cache.get(4, serialized_tree);
+
+        CHECK(cache.size() == 1);
+        CHECK(cache.get(4, serialized_tree) == table2);
+        CHECK(table1->symbol_size() == 8);
+    }
+
+    SECTION("Cache size must be at least 1")
+    {
+        huffman_decoder_table_cache cache;
+        CHECK_THROWS_AS(cache.maximum_size(0), std::invalid_argument);
+    }
+
+        SECTION("Cache does not hold invalid trees")
+    {
+        const vector<unsigned char> serialized_tree = { 0x01, 0xc0, 0x11, 0x02 };
+        huffman_decoder_table_cache cache;
+
+        CHECK_THROWS_AS(cache.get(4, serialized_tree), decode_exception);
+        CHECK(cache.size() == 0);
+    }
+}
+
+}
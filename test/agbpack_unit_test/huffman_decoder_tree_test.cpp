@@ -30,16 +30,45 @@ auto create_huffman_decoder_tree(unsigned int symbol_size, const vector<unsigned
 
 TEST_CASE("huffman_decoder_tree_test")
 {
-    SECTION("create_code_table encounters garbage in unused bits of symbol")
+    SECTION("Tree with garbage in unused bits of symbol is rejected")
     {
         const auto symbol_size = 4;
-        auto tree = create_huffman_decoder_tree(symbol_size, { 0x01, 0xc0, 0x11, 0x02});
 
         CHECK_THROWS_MATCHES(
-            tree.create_code_table(),
+            create_huffman_decoder_tree(symbol_size, { 0x01, 0xc0, 0x11, 0x02}),
             decode_exception,
             Catch::Matchers::Message("encoded data is corrupt: huffman tree contains invalid symbol"));
     }
+
+    SECTION("Tree with node pointing past end of tree is rejected")
+    {
+        const auto symbol_size = 8;
+
+        CHECK_THROWS_MATCHES(
+            create_huffman_decoder_tree(symbol_size, { 0x01, 0x40, 0x01, 0x02}),
+            decode_exception,
+            Catch::Matchers::Message("encoded data is corrupt"));
+    }
+
+    SECTION("Invalid nodes are rejected before any bitstream is decoded")
+    {
+        // The root's second child is an internal node pointing past the end of the tree.
+        // A lazily checking decoder would only notice when decoding a bitstream starting with a 1 bit.
+        const auto symbol_size = 8;
+
+        CHECK_THROWS_AS(
+            create_huffman_decoder_tree(symbol_size, { 0x01, 0x80, 0x61, 0x3f}),
+            decode_exception);
+    }
+
+    SECTION("Nodes shared between parents are accepted")
+    {
+        // Both children of the root are internal nodes pointing to the same pair of leaf nodes.
+        const auto symbol_size = 8;
+        auto tree = create_huffman_decoder_tree(symbol_size, { 0x02, 0x00, 0xc0, 0xc0, 0x61, 0x62});
+
+        CHECK(tree.create_code_table()[0x61].l() == 2);
+    }
 }
 
 }
@@ -29,6 +29,7 @@ TEST_CASE("lzss_bitstream_writer_test")
         writer.write_literal(0x77);
         writer.write_literal(0x88);
         writer.write_literal(0x99);
+        writer.flush();
 
         bitstream expected_bitstream =
         {
@@ -47,6 +48,7 @@ TEST_CASE("lzss_bitstream_writer_test")
         writer.write_literal(0x55);
         writer.write_reference( 3, 0x1000);
         writer.write_reference(18, 0x0001);
+        writer.flush();
 
         bitstream expected_bitstream =
         {
@@ -59,6 +61,23 @@ TEST_CASE("lzss_bitstream_writer_test")
 
         CHECK(actual_bitstream == expected_bitstream);
     }
+
+    SECTION("Complete groups are written without flushing")
+    {
+        for (unsigned char literal = 1; literal <= 8; ++literal)
+        {
+            writer.write_literal(literal);
+        }
+        writer.write_reference(3, 1);
+
+        CHECK(actual_bitstream == bitstream{ 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08 });
+        CHECK(writer.nbytes_written() == 12);
+        CHECK(writer.tag_byte_position() == 9);
+        CHECK(writer.tag_bitmask() == 0x80);
+
+        writer.flush();
+        CHECK(actual_bitstream == bitstream{ 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x80, 0x00, 0x00 });
+    }
 }
 
 }
@@ -0,0 +1,97 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+import agbpack;
+import agbpack_unit_testkit;
+
+namespace agbpack_unit_test
+{
+
+using agbpack::byte_verifier;
+using agbpack::encode_exception;
+using agbpack::lzss_verifying_receiver;
+using agbpack::verify_lzss_stream;
+using byte_vector = std::vector<unsigned char>;
+
+TEST_CASE("lzss_verifying_receiver_test")
+{
+    const byte_vector expected{ 'a', 'b', 'a', 'b', 'a', 'c' };
+    byte_verifier verifier(expected);
+    lzss_verifying_receiver receiver(verifier);
+
+    SECTION("Literals and references producing the expected data")
+    {
+        receiver.tags(0x40);
+        receiver.literal('a');
+        receiver.literal('b');
+        receiver.reference(3, 2);
+        receiver.literal('c');
+
+        CHECK(verifier.nbytes_verified() == 6);
+        CHECK_NOTHROW(verifier.verify_end());
+    }
+
+    SECTION("Unexpected literal")
+    {
+        receiver.literal('a');
+
+        CHECK_THROWS_AS(receiver.literal('a'), encode_exception);
+    }
+
+    SECTION("Reference producing unexpected data")
+    {
+        receiver.literal('a');
+        receiver.literal('b');
+
+        CHECK_THROWS_AS(receiver.reference(2, 1), encode_exception);
+    }
+
+    SECTION("Reference outside of the verified data")
+    {
+        receiver.literal('a');
+
+        CHECK_THROWS_AS(receiver.reference(3, 2), encode_exception);
+    }
+}
+
+TEST_CASE("verify_lzss_stream_test")
+{
+    // Encoded data for abababac, which is: literal a, literal b, reference with length 5 and offset 2, literal c
+    const byte_vector expected{ 'a', 'b', 'a', 'b', 'a', 'b', 'a', 'c' };
+    byte_vector encoded_data{ 0x20, 'a', 'b', 0x20, 0x01, 'c' };
+
+    SECTION("Valid stream")
+    {
+        CHECK_NOTHROW(verify_lzss_stream(expected, encoded_data, {}, false));
+    }
+
+    SECTION("Stream decoding to different data")
+    {
+        encoded_data[5] = 'd';
+
+        CHECK_THROWS_AS(verify_lzss_stream(expected, encoded_data, {}, false), encode_exception);
+    }
+
+    SECTION("Stream which cannot be decoded")
+    {
+        // Reference offset points in front of the decoded data
+        encoded_data[4] = 0x05;
+
+        CHECK_THROWS_AS(verify_lzss_stream(expected, encoded_data, {}, false), encode_exception);
+    }
+
+    SECTION("Stream which is not VRAM safe")
+    {
+        // Encoded data for aaaaaaab, which is: literal a, reference with length 6 and offset 1, literal b
+        const byte_vector vram_unsafe_expected{ 'a', 'a', 'a', 'a', 'a', 'a', 'a', 'b' };
+        const byte_vector vram_unsafe_encoded_data{ 0x40, 'a', 0x30, 0x00, 'b' };
+
+        CHECK_NOTHROW(verify_lzss_stream(vram_unsafe_expected, vram_unsafe_encoded_data, {}, false));
+        CHECK_THROWS_AS(verify_lzss_stream(vram_unsafe_expected, vram_unsafe_encoded_data, {}, true), encode_exception);
+    }
+}
+
+}
@@ -0,0 +1,90 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <cstddef>
+#include <format>
+#include <iterator>
+#include <string>
+#include <vector>
+
+import agbpack;
+import agbpack_unit_testkit;
+
+namespace agbpack_unit_test
+{
+
+using agbpack::estimate_lzss_decode_cycles;
+using agbpack::lzss_decoder;
+using agbpack::optimal_lzss_encoder;
+using byte_vector = std::vector<unsigned char>;
+
+namespace
+{
+
+// Returns text made of randomly chosen words. Unlike data following a simple formula,
+// this has matches of many lengths and offsets, so the encoder has something to choose from.
+byte_vector make_text(std::size_t size)
+{
+    static const char* const words[] = { "the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog ", "and ", "runs ", "away ", "from ", "a ", "big ", "cat ", "\n" };
+
+    std::string text;
+    unsigned int random = 1;
+    while (text.size() < size)
+    {
+        random = random * 1103515245u + 12345u;
+        text += words[(random >> 16) % std::size(words)];
+    }
+
+    return byte_vector(text.begin(), text.end());
+}
+
+template <typename Encoder>
+byte_vector encode_vector(Encoder& encoder, const byte_vector& input)
+{
+    byte_vector output;
+    encoder.encode(input.begin(), input.end(), back_inserter(output));
+    return output;
+}
+
+}
+
+// Lives in the unit tests because the BIOS timings are not exported from agbpack yet.
+TEST_CASE("optimal_lzss_encoder_decode_cycle_weight_test")
+{
+    optimal_lzss_encoder encoder;
+
+    SECTION("Decode cycle weight is 0 by default")
+    {
+        CHECK(encoder.decode_cycle_weight() == 0);
+    }
+
+    SECTION("Encoding with decode cycle weight")
+    {
+        const auto vram_safe = GENERATE(false, true);
+        INFO(std::format("Test parameters: vram_safe={}", vram_safe));
+        const auto original_data = make_text(4000);
+        const auto& timing = vram_safe ? agbpack::lzss_vram_decode_timing : agbpack::lzss_wram_decode_timing;
+        encoder.vram_safe(vram_safe);
+
+        // Encode for minimum size as reference
+        const auto reference_encoded_data = encode_vector(encoder, original_data);
+        const auto reference_cycles = estimate_lzss_decode_cycles(reference_encoded_data.begin(), reference_encoded_data.end(), timing);
+
+        // Encode for minimum decode cycles. Should decode faster, but be at least as big.
+        encoder.decode_cycle_weight(250);
+        const auto encoded_data = encode_vector(encoder, original_data);
+        CHECK(estimate_lzss_decode_cycles(encoded_data.begin(), encoded_data.end(), timing) < reference_cycles);
+        CHECK(encoded_data.size() >= reference_encoded_data.size());
+
+        // Decode
+        lzss_decoder decoder;
+        decoder.vram_safe(vram_safe);
+        byte_vector decoded_data;
+        decoder.decode(encoded_data.begin(), encoded_data.end(), back_inserter(decoded_data));
+        CHECK(decoded_data == original_data);
+    }
+}
+
+}
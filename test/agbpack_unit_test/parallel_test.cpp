@@ -0,0 +1,70 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+import agbpack;
+import agbpack_unit_testkit;
+
+namespace agbpack_unit_test
+{
+
+using agbpack::get_nthreads;
+using agbpack::run_in_parallel;
+using std::size_t;
+
+TEST_CASE("parallel_test")
+{
+    SECTION("get_nthreads")
+    {
+        CHECK(get_nthreads(0) >= 1);
+        CHECK(get_nthreads(1) == 1);
+        CHECK(get_nthreads(5) == 5);
+    }
+
+    SECTION("run_in_parallel runs each task exactly once")
+    {
+        const auto ntasks = GENERATE(size_t(0), size_t(1), size_t(100));
+        const auto nthreads = GENERATE(0u, 1u, 4u);
+        std::vector<int> counts(ntasks);
+
+        run_in_parallel(ntasks, nthreads, [&](size_t i) { ++counts[i]; });
+
+        CHECK(counts == std::vector<int>(ntasks, 1));
+    }
+
+    SECTION("run_in_parallel runs tasks on the calling thread too")
+    {
+        // Each task waits for the other one to start, so each of the two threads runs one task
+        std::atomic<int> nstarted = 0;
+        std::vector<std::thread::id> thread_ids(2);
+
+        run_in_parallel(2, 2, [&](size_t i)
+        {
+            thread_ids[i] = std::this_thread::get_id();
+            ++nstarted;
+            while (nstarted < 2)
+            {
+                std::this_thread::yield();
+            }
+        });
+
+        CHECK(std::ranges::count(thread_ids, std::this_thread::get_id()) == 1);
+    }
+
+    SECTION("run_in_parallel rethrows exceptions thrown by tasks")
+    {
+        const auto nthreads = GENERATE(1u, 4u);
+
+        CHECK_THROWS_AS(run_in_parallel(100, nthreads, [](size_t i) { if (i == 50) { throw std::runtime_error("task failed"); } }), std::runtime_error);
+    }
+}
+
+}
@@ -0,0 +1,50 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <vector>
+#include "test_data_generators.hpp"
+
+import agbpack;
+import agbpack_unit_testkit;
+
+namespace agbpack_unit_test
+{
+
+using agbpack::get_similarity_order;
+using agbpack_test::change_every_nth_byte;
+using agbpack_test::make_test_data;
+using byte_vector = std::vector<unsigned char>;
+using order = std::vector<std::size_t>;
+
+TEST_CASE("similarity_order_test")
+{
+    SECTION("No assets")
+    {
+        CHECK(get_similarity_order({}) == order{});
+    }
+
+    SECTION("Single asset")
+    {
+        CHECK(get_similarity_order({ make_test_data(100) }) == order{ 0 });
+    }
+
+    SECTION("Similar assets are adjacent")
+    {
+        const auto a = make_test_data(1000, 3);
+        const auto b = make_test_data(1000, 7);
+        const auto c = make_test_data(1000, 11);
+
+        CHECK(get_similarity_order({ a, b, c, change_every_nth_byte(b, 50), change_every_nth_byte(a, 50), change_every_nth_byte(c, 50) }) == order{ 0, 4, 1, 3, 2, 5 });
+    }
+
+    SECTION("Ties are broken in favour of the lower index")
+    {
+        const auto a = make_test_data(1000, 3);
+
+        CHECK(get_similarity_order({ a, a, byte_vector{ 1, 2 }, a }) == order{ 0, 1, 3, 2 });
+    }
+}
+
+}
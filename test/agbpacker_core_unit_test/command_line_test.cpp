@@ -90,6 +90,8 @@ TEST_CASE_METHOD(command_line_fixture, "command_line_test")
         CHECK(result.mode == program_mode::compress);
         CHECK(result.method == compression_method::lzss);
         CHECK(result.vram_safe == false);
+        CHECK(result.stats == false);
+        CHECK(result.cache_directory.empty());
     }
 
     SECTION("Output file given")
@@ -162,6 +164,55 @@ TEST_CASE_METHOD(command_line_fixture, "command_line_test")
         CHECK(result.success == true);
         CHECK(result.vram_safe == true);
     }
+
+    SECTION("--level option")
+    {
+        auto [command_line, expected_level] = GENERATE(
+            make_pair("file", 0),
+            make_pair("-l1 file", 1),
+            make_pair("--level 9 file", 9),
+            make_pair("-clzss -l5 file", 5),
+            make_pair("-l5 -clzss file", 5));
+
+        auto result = parse_command_line(command_line);
+
+        CHECK(result.success == true);
+        CHECK(result.level == expected_level);
+    }
+
+    SECTION("--level option with invalid level")
+    {
+        auto command_line = GENERATE("-l10 file", "-l-1 file", "-lx file", "-l1x file");
+
+        auto result = parse_command_line(command_line);
+
+        CHECK(result.success == false);
+    }
+
+    SECTION("--level option with compression method other than LZSS")
+    {
+        auto command_line = GENERATE("-crle -l1 file", "-l1 -crle file", "-l0 -crle file");
+
+        auto result = parse_command_line(command_line);
+
+        CHECK(result.success == false);
+    }
+
+    SECTION("--stats option")
+    {
+        auto result = parse_command_line("--stats file");
+
+        CHECK(result.success == true);
+        CHECK(result.stats == true);
+    }
+
+    SECTION("--cache-dir option")
+    {
+        auto result = parse_command_line("--cache-dir cache file");
+
+        CHECK(result.success == true);
+        CHECK(result.cache_directory == "cache");
+    }
 }
 
 }
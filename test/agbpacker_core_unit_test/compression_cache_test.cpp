@@ -0,0 +1,127 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+import agbpacker_core;
+
+namespace agbpacker_core_unit_test
+{
+
+using agbpacker_core::compression_cache;
+using agbpacker_core::compression_cache_key;
+using agbpacker_core::compression_method;
+using std::vector;
+namespace fs = std::filesystem;
+
+namespace
+{
+
+class compression_cache_fixture
+{
+public:
+    compression_cache_fixture(const compression_cache_fixture&) = delete;
+    compression_cache_fixture& operator=(const compression_cache_fixture&) = delete;
+
+    compression_cache_fixture()
+        : m_directory(fs::temp_directory_path() / std::format("agbpacker_core_unit_test.compression_cache.{}", fs::file_time_type::clock::now().time_since_epoch().count()))
+    {}
+
+    ~compression_cache_fixture()
+    {
+        std::error_code ec;
+        fs::remove_all(m_directory, ec);
+    }
+
+protected:
+    const fs::path& directory() const { return m_directory; }
+
+private:
+    fs::path m_directory;
+};
+
+}
+
+TEST_CASE_METHOD(compression_cache_fixture, "compression_cache_test")
+{
+    const vector<unsigned char> input{ 1, 2, 3, 4 };
+    const vector<unsigned char> output{ 5, 6, 7 };
+    const compression_cache_key key(input, compression_method::lzss, false, 0, "1.0.0");
+
+    SECTION("Lookup in empty cache")
+    {
+        compression_cache cache(directory());
+
+        CHECK(!cache.find(key));
+    }
+
+    SECTION("Lookup of stored data")
+    {
+        compression_cache cache(directory());
+
+        cache.store(key, output);
+
+        CHECK(cache.find(key) == output);
+    }
+
+    SECTION("Keys differing in any component do not find each other's data")
+    {
+        compression_cache cache(directory());
+        cache.store(key, output);
+
+        CHECK(!cache.find(compression_cache_key({ 1, 2, 3, 5 }, compression_method::lzss, false, 0, "1.0.0")));
+        CHECK(!cache.find(compression_cache_key(input, compression_method::optimal_lzss, false, 0, "1.0.0")));
+        CHECK(!cache.find(compression_cache_key(input, compression_method::lzss, true, 0, "1.0.0")));
+        CHECK(!cache.find(compression_cache_key(input, compression_method::lzss, false, 1, "1.0.0")));
+        CHECK(!cache.find(compression_cache_key(input, compression_method::lzss, false, 0, "1.0.1")));
+    }
+
+    SECTION("Level is ignored for compression methods other than LZSS")
+    {
+        const compression_cache_key rle_key(input, compression_method::rle, false, 0, "1.0.0");
+        compression_cache cache(directory());
+        cache.store(rle_key, output);
+
+        CHECK(cache.find(compression_cache_key(input, compression_method::rle, false, 5, "1.0.0")) == output);
+        CHECK(rle_key.file_name().find("level") == std::string::npos);
+    }
+
+    SECTION("Entries whose description does not match the key are not found")
+    {
+        const compression_cache_key other_key(input, compression_method::lzss, false, 1, "1.0.0");
+        compression_cache cache(directory());
+        {
+            std::ofstream file(directory() / key.file_name(), std::ios::binary);
+            file << other_key.description() << '\n';
+            file.write(reinterpret_cast<const char*>(output.data()), static_cast<std::streamsize>(output.size()));
+        }
+
+        CHECK(!cache.find(key));
+    }
+
+    SECTION("Least recently used entries are evicted when the cache grows too big")
+    {
+        const compression_cache_key key2(input, compression_method::rle, false, 0, "1.0.0");
+        const compression_cache_key key3(input, compression_method::h4, false, 0, "1.0.0");
+        const vector<unsigned char> big_output(1000);
+        compression_cache cache(directory(), 2500);
+
+        cache.store(key, big_output);
+        cache.store(key2, big_output);
+        fs::last_write_time(directory() / key.file_name(), fs::file_time_type::clock::now() + std::chrono::hours(1));
+        cache.store(key3, big_output);
+
+        CHECK(cache.find(key) == big_output);
+        CHECK(!cache.find(key2));
+        CHECK(cache.find(key3) == big_output);
+    }
+}
+
+}
@@ -0,0 +1,34 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+import agbpacker_core;
+
+namespace agbpacker_core_unit_test
+{
+
+using agbpacker_core::sha256;
+using agbpacker_core::to_hex_string;
+using std::string_view;
+using std::vector;
+
+TEST_CASE("sha256_test")
+{
+    // Test vectors from FIPS 180-4 examples and NIST CAVP.
+    // The last one needs two padding blocks.
+    auto [input, expected_hash] = GENERATE(
+        std::pair<string_view, string_view>("", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"),
+        std::pair<string_view, string_view>("abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"),
+        std::pair<string_view, string_view>("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"));
+    const vector<unsigned char> data(input.begin(), input.end());
+
+    CHECK(to_hex_string(sha256(data)) == expected_hash);
+}
+
+}
@@ -0,0 +1,41 @@
+// SPDX-FileCopyrightText: 2026 Thomas Mathys
+// SPDX-License-Identifier: MIT
+
+#ifndef AGBPACK_TEST_DATA_GENERATORS_HPP_20261019
+#define AGBPACK_TEST_DATA_GENERATORS_HPP_20261019
+
+#include <cstddef>
+#include <vector>
+
+// Generators for test data, shared by agbpack_test and agbpack_unit_test.
+// Everything in here is defined inline, so no library needs to be linked.
+namespace agbpack_test
+{
+
+// Returns size bytes of data that is somewhat compressible. Different seeds yield different data.
+inline std::vector<unsigned char> make_test_data(std::size_t size, unsigned int seed = 1)
+{
+    std::vector<unsigned char> data(size);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        data[i] = static_cast<unsigned char>((i * i * seed) % 251);
+    }
+
+    return data;
+}
+
+// Returns a copy of data with every nth byte, starting with the first one, incremented.
+// Useful to make similar data.
+inline std::vector<unsigned char> change_every_nth_byte(std::vector<unsigned char> data, std::size_t n)
+{
+    for (std::size_t i = 0; i < data.size(); i += n)
+    {
+        ++data[i];
+    }
+
+    return data;
+}
+
+}
+
+#endif